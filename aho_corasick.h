@@ -0,0 +1,203 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// AHO-CORASICK MULTI-PATTERN SEARCH - shared by project_OMP.c and project_MPI.c
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+When the control file lists several patterns against the same text, all of them are searched for
+in a single pass over the text with an Aho-Corasick automaton instead of one scan per pattern.
+
+The automaton is built as a full transition table (the trie with the failure links folded in) so
+each text character costs one table lookup. To keep the table small, only the bytes that appear in
+at least one pattern get a column; every other byte maps to column 0, which always leads back to
+the root. Each state also has a dictionary link to the nearest shorter state on its failure chain
+that ends a pattern, so all patterns ending at a text position are found without walking the whole
+failure chain.
+
+Patterns are identified by their keyword index, the order they were passed to buildAhoCorasick.
+The same pattern may be passed more than once, every copy is reported.
+*/
+
+typedef struct ahoCorasick
+{
+	int alphabetSize; //number of columns in the transition table, including column 0 for unused bytes
+	unsigned char charIndex[256]; //column used for each byte
+	int numStates;
+	int *transitions; //numStates * alphabetSize next states
+	int *dictionaryLink; //nearest state on the failure chain that ends a keyword, 0 if none
+	int *firstKeyword; //first keyword ending at each state, -1 if none
+	int *nextKeyword; //next keyword ending at the same state, -1 if none
+	int *keywordLength;
+	int numKeywords;
+	int minKeywordLength;
+	int maxKeywordLength;
+} ahoCorasick_;
+
+/*
+Called for every occurrence found by scanAhoCorasick. Returning false stops the scan early.
+*/
+typedef bool (*ahoCorasickMatch_)(void *context, int keyword, long long startPos);
+
+static void freeAhoCorasick(ahoCorasick_ *automaton)
+{
+	free(automaton->transitions);
+	free(automaton->dictionaryLink);
+	free(automaton->firstKeyword);
+	free(automaton->nextKeyword);
+	free(automaton->keywordLength);
+	memset(automaton, 0, sizeof(ahoCorasick_));
+}
+
+/*
+This method builds the automaton for numKeywords non-empty patterns.
+Returns false if memory could not be allocated.
+*/
+static bool buildAhoCorasick(ahoCorasick_ *automaton, char **keywords, const int *lengths, int numKeywords)
+{
+	int totalLength = 0;
+	int *failure = NULL;
+	int *queue = NULL;
+	int head = 0, tail = 0;
+
+	memset(automaton, 0, sizeof(ahoCorasick_));
+	automaton->numKeywords = numKeywords;
+	automaton->minKeywordLength = numKeywords > 0 ? lengths[0] : 0;
+
+	//give every byte that appears in a pattern its own column
+	automaton->alphabetSize = 1;
+	for (int k = 0; k < numKeywords; k++)
+	{
+		totalLength += lengths[k];
+		if (lengths[k] < automaton->minKeywordLength)
+			automaton->minKeywordLength = lengths[k];
+		if (lengths[k] > automaton->maxKeywordLength)
+			automaton->maxKeywordLength = lengths[k];
+		for (int i = 0; i < lengths[k]; i++)
+		{
+			unsigned char c = (unsigned char) keywords[k][i];
+			if (automaton->charIndex[c] == 0)
+				automaton->charIndex[c] = (unsigned char) automaton->alphabetSize++;
+		}
+	}
+
+	//there is at most one state per pattern character plus the root
+	int maxStates = totalLength + 1;
+	int width = automaton->alphabetSize;
+	automaton->transitions = (int *) malloc(sizeof(int) * (size_t) maxStates * width);
+	automaton->dictionaryLink = (int *) calloc(maxStates, sizeof(int));
+	automaton->firstKeyword = (int *) malloc(sizeof(int) * maxStates);
+	automaton->nextKeyword = (int *) malloc(sizeof(int) * (numKeywords > 0 ? numKeywords : 1));
+	automaton->keywordLength = (int *) malloc(sizeof(int) * (numKeywords > 0 ? numKeywords : 1));
+	failure = (int *) calloc(maxStates, sizeof(int));
+	queue = (int *) malloc(sizeof(int) * maxStates);
+	if (automaton->transitions == NULL || automaton->dictionaryLink == NULL || automaton->firstKeyword == NULL ||
+		automaton->nextKeyword == NULL || automaton->keywordLength == NULL || failure == NULL || queue == NULL)
+	{
+		free(failure);
+		free(queue);
+		freeAhoCorasick(automaton);
+		return false;
+	}
+
+	//insert every pattern into the trie, -1 marks a missing edge
+	memset(automaton->transitions, -1, sizeof(int) * (size_t) maxStates * width);
+	automaton->firstKeyword[0] = -1;
+	automaton->numStates = 1;
+	for (int k = 0; k < numKeywords; k++)
+	{
+		int state = 0;
+		for (int i = 0; i < lengths[k]; i++)
+		{
+			int column = automaton->charIndex[(unsigned char) keywords[k][i]];
+			int *next = &automaton->transitions[(size_t) state * width + column];
+			if (*next == -1)
+			{
+				*next = automaton->numStates;
+				automaton->firstKeyword[automaton->numStates] = -1;
+				automaton->numStates++;
+			}
+			state = *next;
+		}
+		automaton->keywordLength[k] = lengths[k];
+		automaton->nextKeyword[k] = automaton->firstKeyword[state];
+		automaton->firstKeyword[state] = k;
+	}
+
+	//breadth first pass to fill in the failure links and fold them into the transition table
+	for (int c = 0; c < width; c++)
+	{
+		int child = automaton->transitions[c];
+		if (child == -1)
+			automaton->transitions[c] = 0;
+		else
+		{
+			failure[child] = 0;
+			queue[tail++] = child;
+		}
+	}
+	while (head < tail)
+	{
+		int state = queue[head++];
+		int fail = failure[state];
+		automaton->dictionaryLink[state] = automaton->firstKeyword[fail] != -1 ? fail : automaton->dictionaryLink[fail];
+		for (int c = 0; c < width; c++)
+		{
+			int *next = &automaton->transitions[(size_t) state * width + c];
+			int failNext = automaton->transitions[(size_t) fail * width + c];
+			if (*next == -1)
+				*next = failNext;
+			else
+			{
+				failure[*next] = failNext;
+				queue[tail++] = *next;
+			}
+		}
+	}
+
+	free(failure);
+	free(queue);
+	return true;
+}
+
+/*
+This method scans the text from position from, starting at the root, and reports every keyword
+occurrence that starts between from and lastStart (inclusive) and ends before textEnd. Occurrences
+that start before from are not seen, so consecutive blocks can be scanned independently as long
+as each block scans on past its lastStart by maxKeywordLength - 1 characters.
+Returns false if the callback stopped the scan.
+*/
+static bool scanAhoCorasick(const ahoCorasick_ *automaton, const char *textChars, long long from, long long lastStart,
+	long long textEnd, ahoCorasickMatch_ onMatch, void *context)
+{
+	const unsigned char *text = (const unsigned char *) textChars;
+	int width = automaton->alphabetSize;
+	int state = 0;
+	long long scanEnd = lastStart + automaton->maxKeywordLength; //one past the last character a reported match can use
+	if (scanEnd > textEnd)
+		scanEnd = textEnd;
+
+	for (long long i = from; i < scanEnd; i++)
+	{
+		state = automaton->transitions[(size_t) state * width + automaton->charIndex[text[i]]];
+		int output = automaton->firstKeyword[state] != -1 ? state : automaton->dictionaryLink[state];
+		while (output != 0)
+		{ //report every keyword ending here, longest first
+			for (int k = automaton->firstKeyword[output]; k != -1; k = automaton->nextKeyword[k])
+			{
+				long long startPos = i - automaton->keywordLength[k] + 1;
+				if (startPos <= lastStart && !onMatch(context, k, startPos))
+					return false;
+			}
+			output = automaton->dictionaryLink[output];
+		}
+	}
+	return true;
+}
+
+#endif
@@ -13,5 +13,6 @@
 gcc -fopenmp -O2 -o project_OMP project_OMP.c
 rm -f inputs
 ln -s $1 inputs
+export OMP_CANCELLATION=true
 time ./project_OMP large_inputs
 sort -k 1,1n -k 2,2n -k 3,3n result_OMP.txt > sorted_OMP.txt
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# Gives a name for the job
+#SBATCH --job-name=BENCHMARK
+
+# Ask the scheduler for Y CPU cores on the same compute node
+#SBATCH --ntasks=1
+#SBATCH --cpus-per-task=4
+
+# Set the name of the output file
+#SBATCH -o BENCHMARK.out
+
+# Build the kernel benchmark from project_OMP.c, it generates its own texts so no inputs are needed
+gcc -fopenmp -O2 -DBENCHMARK -o benchmark_OMP project_OMP.c -lm
+export OMP_CANCELLATION=true
+
+# Random text over a DNA sized alphabet, a rare pattern and a dense one, and the naive worst case
+./benchmark_OMP --corpus=random --alphabet=4 --size=268435456 --pattern-length=16 --threads=1,2,4 > benchmark_OMP.csv
+./benchmark_OMP --corpus=random --alphabet=4 --size=268435456 --pattern-length=16 --density=1000 --threads=1,2,4 | tail -n +2 >> benchmark_OMP.csv
+./benchmark_OMP --corpus=worst --size=67108864 --pattern-length=64 --threads=1,2,4 | tail -n +2 >> benchmark_OMP.csv
+cat benchmark_OMP.csv
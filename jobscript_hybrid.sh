@@ -0,0 +1,23 @@
+#!/bin/bash
+
+#Gives a name for the job
+#SBATCH --job-name=HYBRID
+
+# Ask the scheduler to run one MPI process on each of N compute nodes, with Y CPU cores for each process's threads
+#SBATCH --nodes=4
+#SBATCH --ntasks=4
+#SBATCH --ntasks-per-node=1
+#SBATCH --cpus-per-task=4
+
+# Set the name of the output file
+#SBATCH -o HYBRID.out
+
+# Load mpi module
+module add mpi/openmpi
+
+mpicc -fopenmp -O2 -o project_hybrid project_MPI.c
+rm -f inputs
+ln -s $1 inputs
+export OMP_NUM_THREADS=$SLURM_CPUS_PER_TASK
+time mpirun -np 4 --bind-to none ./project_hybrid large_inputs --threads=$SLURM_CPUS_PER_TASK
+sort -k 1,1n -k 2,2n -k 3,3n result_MPI.txt > sorted_MPI.txt
@@ -0,0 +1,124 @@
+#!/bin/bash
+
+# Gives a name for the job
+#SBATCH --job-name=SCALING
+
+# Ask the scheduler for Y CPU cores on the same compute node, the MPI runs oversubscribe them if needed
+#SBATCH --ntasks=1
+#SBATCH --cpus-per-task=8
+
+# Set the name of the output file
+#SBATCH -o SCALING.out
+
+# Strong and weak scaling study for project_OMP and project_MPI on one machine.
+# usage: ./jobscript_scaling.sh [max workers] [strong text bytes] [weak text bytes per worker]
+# Runs project_OMP with --threads=1,2,4... and project_MPI with -np 1,2,4... up to max workers, on a fixed
+# total text (strong scaling) and on a text that grows with the number of workers (weak scaling).
+# Every result file is checked against a sequential reference (project_OMP --threads=1 --engine=naive),
+# and scaling.csv gets one line per run and phase with the wall time, speedup and parallel efficiency.
+# The phases come from the programs' --metrics output (see metrics.h): load, distribute (MPI only), search
+# (including preparing the engine), gather (MPI only) and write, summed over the control file, plus the total.
+
+MAX_WORKERS=${1:-8}
+STRONG_BYTES=${2:-268435456}
+WEAK_BYTES=${3:-33554432}
+MPIRUN=${MPIRUN:-"mpirun --oversubscribe"} # add --allow-run-as-root here if needed
+ROOT=$(pwd)
+WORK=$ROOT/scaling
+RAW=$WORK/raw.csv
+
+# Load mpi module
+module add mpi/openmpi 2>/dev/null
+
+gcc -fopenmp -O2 -o project_OMP project_OMP.c || exit 1
+mpicc -O2 -o project_MPI project_MPI.c || exit 1
+export OMP_CANCELLATION=true
+
+# make_inputs dir bytes: two texts sharing the given size over the alphabet abcd, a pattern that never
+# occurs (full scan), a frequent one and a rarer one, searched as a group on text 1 and alone on text 2
+make_inputs() {
+	mkdir -p $1/large_inputs
+	tr -dc 'abcd' < /dev/urandom | head -c $(($2 / 2)) > $1/large_inputs/text1.txt
+	tr -dc 'abcd' < /dev/urandom | head -c $(($2 / 2)) > $1/large_inputs/text2.txt
+	printf 'abcdabcdabcdabce' > $1/large_inputs/pattern1.txt
+	printf 'abca' > $1/large_inputs/pattern2.txt
+	printf 'dcbadcbaab' > $1/large_inputs/pattern3.txt
+	printf '0 1 1\n1 1 2\n0 1 3\n1 2 3\n0 2 1\n' > $1/large_inputs/control.txt
+	(cd $1 && $ROOT/project_OMP large_inputs --threads=1 --engine=naive > /dev/null && sort result_OMP.txt > reference.txt)
+}
+
+# run study program workers bytes dir: time one run and record its phases
+run() {
+	local study=$1 program=$2 workers=$3 bytes=$4 dir=$5
+	local start end total correct
+	cd $dir
+	rm -f result_$program.txt
+	start=$(date +%s.%N)
+	if [ $program = OMP ]; then
+		$ROOT/project_OMP large_inputs --threads=$workers --metrics > run.log 2>&1
+	else
+		$MPIRUN -np $workers $ROOT/project_MPI large_inputs --metrics > run.log 2>&1
+	fi
+	end=$(date +%s.%N)
+	total=$(echo "$start $end" | awk '{ printf "%.6f", $2 - $1 }')
+	if sort result_$program.txt 2>/dev/null | cmp -s - reference.txt; then correct=yes; else correct=no; fi
+	cd $ROOT
+	echo "$study,$program,$workers,$bytes,total,$total,$correct" >> $RAW
+	# times shared by a group of entries searched in one pass are repeated on each of its lines, so divide them by the group size.
+	# The columns are found by their names in the header, so a new metrics column does not shift them. overlap_s is left out,
+	# it is only set by project_MPI --pipeline, which these runs do not use.
+	awk -F, -v prefix="$study,$program,$workers,$bytes" -v correct=$correct 'NR == 1 {
+			for (i = 1; i <= NF; i++) col[$i] = i
+			next
+		} {
+			group = $col["group_size"]
+			load += $col["load_s"] / group; distribute += $col["distribute_s"] / group
+			search += ($col["prepare_s"] + $col["search_s"]) / group; gather += $col["gather_s"]; write += $col["write_s"]
+		} END {
+			printf "%s,load,%.6f,%s\n", prefix, load, correct
+			printf "%s,distribute,%.6f,%s\n", prefix, distribute, correct
+			printf "%s,search,%.6f,%s\n", prefix, search, correct
+			printf "%s,gather,%.6f,%s\n", prefix, gather, correct
+			printf "%s,write,%.6f,%s\n", prefix, write, correct
+		}' $dir/metrics_$program.csv >> $RAW
+	echo "$study $program workers=$workers bytes=$bytes total=${total}s correct=$correct"
+}
+
+rm -rf $WORK
+mkdir -p $WORK
+: > $RAW
+
+# strong scaling: the same inputs for every worker count
+make_inputs $WORK/strong $STRONG_BYTES
+for ((workers = 1; workers <= MAX_WORKERS; workers *= 2)); do
+	run strong OMP $workers $STRONG_BYTES $WORK/strong
+	run strong MPI $workers $STRONG_BYTES $WORK/strong
+done
+
+# weak scaling: the inputs grow with the number of workers
+for ((workers = 1; workers <= MAX_WORKERS; workers *= 2)); do
+	make_inputs $WORK/weak$workers $((WEAK_BYTES * workers))
+	run weak OMP $workers $((WEAK_BYTES * workers)) $WORK/weak$workers
+	run weak MPI $workers $((WEAK_BYTES * workers)) $WORK/weak$workers
+	rm -rf $WORK/weak$workers/large_inputs
+done
+
+# speedup and efficiency against one worker of the same study, program and phase
+# strong: speedup = T1 / Tp and efficiency = speedup / p, weak: efficiency = T1 / Tp and speedup = p * efficiency
+awk -F, 'BEGIN { OFS = ","; print "study,program,workers,text_bytes,phase,seconds,speedup,efficiency,correct" }
+	{
+		key = $1 "," $2 "," $5
+		if ($3 == 1) base[key] = $6
+		speedup = efficiency = 0
+		if ($6 > 0 && base[key] > 0)
+		{
+			if ($1 == "strong") { speedup = base[key] / $6; efficiency = speedup / $3 }
+			else { efficiency = base[key] / $6; speedup = efficiency * $3 }
+		}
+		print $1, $2, $3, $4, $5, $6, sprintf("%.3f", speedup), sprintf("%.3f", efficiency), $7
+	}' $RAW > scaling.csv
+cat scaling.csv
+if grep -q ',no$' scaling.csv; then
+	echo "Some results did not match the sequential reference"
+	exit 1
+fi
@@ -0,0 +1,82 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// PER SEARCH METRICS - shared by project_OMP.c and project_MPI.c
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+With --metrics each program writes one CSV line per control entry to metrics_OMP.csv or metrics_MPI.csv,
+next to its result file. A line records the text and pattern searched, their sizes, the number of
+matches and the wall time of each phase of the search: loading the files, preparing the search engine
+or automaton, distributing the text (MPI only), searching, gathering the results (MPI only) and writing
+them. It also records how long each thread (OMP) or process (MPI) spent searching, and the imbalance
+between them as the slowest worker's time over the mean, so 1.00 is a perfectly balanced search.
+
+Entries that share a text are searched together in one pass. Their lines repeat the load, prepare,
+distribute and search times of the whole group and give the group size, so the shared time is only
+counted once when the group size is taken into account.
+
+With --pipeline the MPI master reads the text of the next search while it searches the current one.
+The line of a search read this way gives the time the master spent waiting for its files as load_s,
+and the time its text was being read alongside the search before it as overlap_s. It is 0 otherwise.
+*/
+
+typedef struct searchMetrics
+{
+	int groupSize; //number of entries searched in the same pass
+	long long textBytes;
+	long long patternBytes;
+	long long matches; //positions found for a type '1' or '2' search, 1 or 0 for a type '0' search
+	double loadSeconds;
+	double overlapSeconds; //time the text was read alongside the previous search, MPI with --pipeline only
+	double prepareSeconds;
+	double distributeSeconds;
+	double searchSeconds;
+	double gatherSeconds;
+	double writeSeconds;
+	int numWorkers;
+	double *workerSearchSeconds; //search time of each thread or process
+} searchMetrics_;
+
+/*
+This method creates the metrics file and writes the CSV header, returning NULL if it can not be created
+*/
+static inline FILE *openMetricsFile(const char *fileName)
+{
+	FILE *file = fopen(fileName, "w");
+	if (file == NULL)
+	{
+		printf("Unable to create metrics file %s\n", fileName);
+		return NULL;
+	}
+	fprintf(file, "text,pattern,type,group_size,text_bytes,pattern_bytes,matches,load_s,overlap_s,prepare_s,distribute_s,search_s,gather_s,write_s,worker_search_s,imbalance\n");
+	return file;
+}
+
+/*
+This method writes the metrics of one control entry as a line of the metrics file. The worker search
+times are written as one field separated by semicolons.
+*/
+static inline void writeMetrics(FILE *file, const char *textNumber, const char *patternNumber, char typeOfRead, const searchMetrics_ *metrics)
+{
+	double slowest = 0, total = 0;
+	fprintf(file, "%s,%s,%c,%d,%lld,%lld,%lld,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,", textNumber, patternNumber, typeOfRead,
+		metrics->groupSize, metrics->textBytes, metrics->patternBytes, metrics->matches, metrics->loadSeconds, metrics->overlapSeconds,
+		metrics->prepareSeconds, metrics->distributeSeconds, metrics->searchSeconds, metrics->gatherSeconds,
+		metrics->writeSeconds);
+	for (int w = 0; w < metrics->numWorkers; w++)
+	{
+		fprintf(file, w == 0 ? "%.6f" : ";%.6f", metrics->workerSearchSeconds[w]);
+		total += metrics->workerSearchSeconds[w];
+		if (metrics->workerSearchSeconds[w] > slowest)
+			slowest = metrics->workerSearchSeconds[w];
+	}
+	fprintf(file, ",%.2f\n", total > 0 ? slowest / (total / metrics->numWorkers) : 1.0);
+	fflush(file);
+}
+
+#endif
@@ -6,7 +6,17 @@
 #include <math.h>
 #include <time.h>
 #include <ctype.h>
+#include <limits.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "text_io.h"
+#include "search_engines.h"
+#include "aho_corasick.h"
+#include "metrics.h"
+#include "text_index.h"
+#include "qgram_filter.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // MPI PROJECT - SHEA KITSON - 40202515
@@ -23,86 +33,280 @@ STATEGIES TO OPTIMISE PERFORMANCE:
 The fine grain approach is better for searches made up of mixed large and small inputs. Each thread is searching through an
 even amount of text no matter how large the text is. 
 
+When checking if a pattern exists, each process searches its portion in blocks and keeps a nonblocking MPI_Iallreduce running in
+the background to learn whether any process has found the pattern, so all processes stop shortly after the first hit instead of
+waiting for the slowest process to finish its whole portion.
+
+Each search is shared out with collectives rather than a loop of sends from the master: the search metadata is packed into one
+struct sent with MPI_Bcast, the pattern is broadcast once, and the overlapping portions of text are sent with one MPI_Ialltoallw.
+Every process works out its own start index, so setting up a search takes a logarithmic number of steps in the number of processes.
+
+Text offsets, lengths and positions are 64-bit throughout, so texts larger than 2GB can be searched. MPI counts are int, so
+anything that can pass INT_MAX elements is sent as one element of a derived datatype built by largeCountType: blocks of
+LARGE_COUNT_BLOCK elements plus the remainder, placed at a byte displacement that can itself be larger than INT_MAX.
+
 If either the text or pattern file is empty, or if the text file is shorter than the pattern file, then the search is skipped as it 
 is impossible for the pattern to be found when any of these things are true. When this happens I report it as pattern not found.
 
-The linked list structure that is used to hold all occurances of a pattern will dynamically allocate its memory each time a new element 
-is added to the list. Although this does not directly affect how fast the program executes, it means I am not statically allocating more
-memory than necessary to hold the results.
+The text and pattern files are memory mapped read-only (see text_io.h) rather than copied in one byte at a time, so loading
+a large text no longer costs more than searching it. readData prints the load throughput for each search.
+
+With --pipeline the master looks ahead in the control file. Before it searches its portion of a single search it starts
+reading the text of the next one with MPI_File_iread_at and sends its pattern with nonblocking collectives. Once its own
+search is done it waits for the read and starts sending the portions, and the other processes receive them into a second
+buffer while the results are reduced, so reading and sending the next search is hidden behind the current one. The
+metrics give the time each staged text was read alongside the search before it as overlap_s.
+
+With --parallel-io the master only broadcasts the text number, its size and the pattern, and every process reads its own
+portion of the text straight from disk with a collective MPI_File_read_at_all, so no single process has to hold or copy the whole text.
+
+With --stream no process ever holds a whole text or portion. The master broadcasts the pattern and text number as with
+--parallel-io, and each process reads its share of the text in chunks of --chunk-size= start positions with MPI_File_iread_at,
+reading the next chunk while it searches the current one. Each chunk carries patternLength - 1 characters over into the next,
+so texts larger than the memory of the processes can be searched. Searches are not grouped in this mode.
+
+With --shared-memory the processes on each node, found with MPI_Comm_split_type, share one copy of the text in a window made
+with MPI_Win_allocate_shared. The master sends each node's first process that node's part of the text in one message, and every
+process searches its own portion in place in the window, so a node holding many processes no longer holds the text many times
+over and nothing is sent between processes on the same node. Searches sent ahead by --pipeline are still copied to each process.
+
+With --dynamic the master no longer gives each process a fixed portion of the text. It cuts the text into chunks of
+--dynamic-chunk-size= start positions (4M by default) and sends the next chunk, with the patternLength - 1 characters after it, to
+whichever process asks first. Each process asks again with the results of its last chunk as soon as it has searched it, so a process
+on a slow or busy node just searches fewer chunks rather than holding up the search. The master prints how many chunks each process
+searched after every search and in total at the end, so straggling nodes can be spotted. Searches are not grouped in this mode.
+
+With --farm the master first hands out every text of up to --farm-threshold= bytes (32MB by default), with all of its
+searches, whole to a single process, largest text first, sending each process its next text as soon as it returns the results.
+A small text costs more to split and send than to search, so a batch of small texts is shared out between the processes instead,
+and only the larger texts that are left are split across every process as usual. Each process reads the texts it is sent itself.
+
+Building with -fopenmp (see jobscript_hybrid.sh) gives a hybrid MPI+OpenMP program: each process splits its portion into blocks
+searched by --threads= OpenMP threads, so one process per node can use every core on the node. Only the main thread calls MPI.
+
+Each process searches its portion with a pluggable engine (see search_engines.h) chosen with --engine=naive|horspool|twoway.
+
+The master reads the whole control file up front and entries that use the same text are searched together: the text is
+distributed once and each process finds all of the group's patterns in its portion with a single Aho-Corasick pass.
+
+When a text has a suffix array index newer than it (built with project_OMP --build-index, see text_index.h), the master answers
+every entry on that text from the index with a binary search on its own, and the other processes skip the group. Nothing is sent,
+as a lookup in the index touches far less of the text than distributing it would.
+
+Type '0' searches are first checked against the text's q-gram filter if it has one (built with project_OMP --build-filter, see
+qgram_filter.h). The master answers a search whose pattern has a 3-gram missing from the text with -1 on its own, so a pattern that
+is not there no longer costs reading, distributing and scanning the whole text.
+
+With --metrics the master writes the time taken by each phase of every search, and each process's search time, to metrics_MPI.csv
+(see metrics.h), so load imbalance and searches dominated by reading or distributing the text show up.
+
+A type '2' search only counts the occurrences of the pattern and writes one line with the count. Each process counts the matches
+in its portion, the threads of the hybrid build summing theirs with an OpenMP reduction(+), and the counts are combined on the master
+with one MPI_Reduce using MPI_SUM, so no positions are stored or sent. Streams, --dynamic chunks, --farm jobs, groups, the suffix
+array index and the q-gram filter (a count of 0) all answer type '2' searches the same way.
+
+Each process stores the positions it finds in a growable array, in ascending order, and converts them to positions in the full text.
+The master collects them all with a single MPI_Alltoallw into one array (or, from TREE_MERGE_MIN_PROCESSES processes, a binary tree of pairwise merges)
+instead of one message per match. Each start position belongs to exactly one process, so a match in the overlap between two portions
+is only reported once and the arrays laid end to end in rank order are already the sorted result, with no duplicates to remove.
 */
 
 
 MPI_Status status;
 
-typedef struct linkedList 
-{ //define linked list structure which is used to store all positions that pattern is found
-    int index;
-    struct linkedList* next;
-}linkedList_;
+#define TREE_MERGE_MIN_PROCESSES 32 //from this many processes the results of a type '1' search are merged up a tree instead of gathered to the master
 
-void pushToList(linkedList_ ** head, int value)
-{ //This method will push a value to the front of the linked list
-	linkedList_* foundAt;
-	foundAt = (linkedList_*) malloc(sizeof(linkedList_));
-	foundAt->index = value;
-	foundAt->next= *head;
-	*head = foundAt;
-}
+typedef struct positionList 
+{ //growable array used to store all positions that pattern is found, in ascending order
+    long long *positions; //positions in the text, 64-bit so texts larger than 2GB can be searched
+    long long count;
+    long long allocated;
+}positionList_;
 
 char *textData;
-int textLength;
+long long textLength; //64-bit so texts larger than 2GB can be searched
+bool textMapped = false; //true if textData is a read-only mapping of the text file rather than a heap buffer
 
 char *patternData;
-int patternLength;
+long long patternLength;
+bool patternMapped = false; //true if patternData is a read-only mapping of the pattern file
 
 char *controlData; //stores the data from the control file
-int controlLength; //stores length of control file
+long long controlLength; //stores length of control file
 
-char typeOfRead; //stores the type of search to be done, i.e. '0' to find if pattern exists or '1' to find all occurances of pattern
+char typeOfRead; //stores the type of search to be done, i.e. '0' to find if pattern exists, '1' to find all occurances of pattern or '2' to count them
 char* textNumber; //stores text number to be searched
 char* patternNumber; //stores pattern number that the program is searching for
 
-unsigned int combinedResult; //used to reduce the results from all processes in a type '0' search to either -2 (found) or -1 (not found)
-linkedList_* allResults; //used to reduce the results from all processes in a type '1' search, will contain every position a pattern is found
+int combinedResult; //used to reduce the results from all processes in a type '0' search to either -2 (found) or -1 (not found)
+positionList_ allResults; //used to reduce the results from all processes in a type '1' search, will contain every position a pattern is found
+long long combinedCount; //used to reduce the counts from all processes in a type '2' search to the total number of matches
 
-char *textPortion; //separate array to store portions of text so that the master process can divide it up between processes
-int portionLength; //variable to store length of a portion of text
-int startIndex; //used by each process to store their starting index to search in the main textData
-int numPatternsFound; //used to count the number of patterns found by each process
+long long startIndex; //used by each process to store their starting index to search in the main textData
+long long lastOwnedStart; //last start position in textData that belongs to this process, later ones belong to the next process
+long long numPatternsFound; //used to count the number of patterns found by each process, the only result kept by a type '2' search
 int exists; //will be set by each process to -2 if they find the pattern or -1 if they dont
-linkedList_* foundAt; //will contain all the positions of where the pattern is found by each process
+positionList_ foundAt; //will contain all the positions of where the pattern is found by each process
 
 int worldRank; //used by each process to query their world rank
 int worldSize; //common accross all process, set using the -np flag in the run script
 
+typedef struct controlEntry
+{ //one line of the control file
+	char typeOfRead;
+	char *textNumber;
+	char *patternNumber;
+	bool done; //set once the entry has been taken to be searched, possibly as part of a group sharing its text
+} controlEntry_;
+
+controlEntry_ *controlEntries; //every entry in the control file, read up front by the master so entries sharing a text can be grouped
+int numControlEntries;
+
 bool controlRead = false; //indicates if the control file read has been started or not
 int allSearchesDone = 0; //indicates if all of the searches are complete, changes to 1 once they are all complete
 
 FILE *outputFile; //File to output results
 
-void extractPortion(int startIndex, int endIndex, int size) 
-{//this method will extract a certain size portion from the textData from the given start index to the end index
-	textPortion = (char *)realloc(textPortion, sizeof(char) * size); //allocate required amount of memory for array
-	for (int i = startIndex; i <= endIndex; i++)
-	{
-		textPortion[i - startIndex] = textData[i]; 
-	}
-}
-
-void sendPortionOfText(int sendTo, int startIndex, int maxEndIndex)
-{ //this method will be used by the master process to send the allocated portion of text to all other processes
-	int sizeToSend = maxEndIndex - startIndex;
-	extractPortion(startIndex, maxEndIndex, sizeToSend);
-	MPI_Send(&sizeToSend, 1, MPI_INT, sendTo, 100, MPI_COMM_WORLD);
-	MPI_Send(textPortion, sizeToSend, MPI_CHAR, sendTo, 200, MPI_COMM_WORLD);
-}
-
-void sendPattern(int sendTo)
-{ //this method will be used by the master process to send the current pattern to all other processes
-	MPI_Send(&patternLength, 1, MPI_INT, sendTo, 100, MPI_COMM_WORLD);
-	MPI_Send(patternData, patternLength, MPI_CHAR, sendTo, 200, MPI_COMM_WORLD);
-}
-
+#define SEARCH_BLOCK_SIZE 65536 //number of start positions each thread searches as one unit of work in the hybrid build
+int threadsPerRank = 1; //number of OpenMP threads each process searches with, set by --threads= when built with -fopenmp
+
+bool parallelIO = false; //set by --parallel-io, each process reads its own portion of the text instead of the master sending it
+char textNumberBuffer[1000]; //copy of the text number broadcast to the other processes when parallelIO is set
+
+bool pipeline = false; //set by --pipeline, the master reads and sends the next search while the current one runs
+
+bool farm = false; //set by --farm, searches on small texts are handed out whole to single processes before the rest are split
+long long farmThreshold = 32 * 1024 * 1024; //set with --farm-threshold=, texts larger than this many bytes are still split across every process
+#define FARM_JOB_TAG 70
+#define FARM_REPLY_TAG 80
+#define FARM_POSITIONS_TAG 90
+
+typedef struct farmReply
+{ //result of one entry of a job, sent back to the master by --farm
+	long long exists; //-2 if a type '0' search found the pattern, otherwise -1
+	long long count; //matches found by a type '1' or '2' search, the positions of a type '1' search follow in a message of their own
+	long long textLength;
+	long long patternLength;
+	long long searchNanoseconds;
+} farmReply_;
+#define FARM_REPLY_LONGS ((int) (sizeof(farmReply_) / sizeof(long long)))
+
+typedef struct farmJob
+{ //every entry on one small text, handed out whole by --farm
+	int firstEntry; //where the job's entries start in the master's list of farmed entries
+	int numEntries;
+	long long textSize;
+} farmJob_;
+
+bool streamText = false; //set by --stream, each process reads and searches its share of the text a chunk at a time
+int streamChunkSize = 64 * 1024 * 1024; //number of start positions in each chunk, set with --chunk-size=
+
+typedef struct textStream
+{ //this process's share of a text being read a chunk at a time when streamText is set
+	MPI_File file;
+	long long firstStart; //first start position in the full text searched by this process
+	long long lastStart; //last start position in the full text searched by this process
+	long long numChunks;
+	long long nextChunk; //next chunk to be searched
+	char *buffers[2]; //the chunk being searched and the one being read ahead of it
+	MPI_Request read; //read of the next chunk, MPI_REQUEST_NULL if none is running
+	char *savedText; //textData before the stream took it over
+} textStream_;
+
+bool sharedMemory = false; //set by --shared-memory, processes on the same node search one copy of the text in a shared window
+MPI_Comm nodeComm = MPI_COMM_NULL; //every process on this node, found with MPI_Comm_split_type
+MPI_Comm leaderComm = MPI_COMM_NULL; //the first process on every node, MPI_COMM_NULL on the others
+int nodeRank = 0; //rank of this process in nodeComm, 0 for the node's leader
+MPI_Win nodeWindow = MPI_WIN_NULL; //the node's copy of the text for the current search
+char *ownText = NULL; //this process's own text buffer, put aside while textData points into nodeWindow
+#define NODE_TEXT_TAG 140
+
+bool dynamicChunks = false; //set by --dynamic, the master hands out chunks of the text to the other processes as they ask for them
+int dynamicChunkSize = 4 * 1024 * 1024; //number of start positions in each chunk handed out, set with --dynamic-chunk-size=
+long long *chunksSearched = NULL; //number of chunks each process has searched with --dynamic, kept by the master
+#define DYNAMIC_REQUEST_TAG 100
+#define DYNAMIC_CHUNK_TAG 110
+#define DYNAMIC_TEXT_TAG 120
+#define DYNAMIC_POSITIONS_TAG 130
+
+typedef struct chunkRequest
+{ //sent to the master by a process with --dynamic to return the results of its last chunk and ask for the next one
+	long long chunk; //chunk just searched, -1 for the first request of a search
+	long long exists; //-2 if a type '0' search found the pattern in the chunk, otherwise -1
+	long long count; //matches found by a type '1' or '2' search, the positions of a type '1' search follow in a message of their own
+} chunkRequest_;
+#define CHUNK_REQUEST_LONGS ((int) (sizeof(chunkRequest_) / sizeof(long long)))
+
+typedef struct chunkHeader
+{ //sent by the master with --dynamic ahead of the text of a chunk
+	long long chunk; //-1 once there are no chunks left
+	long long start; //first start position of the chunk in the full text
+	long long length; //characters sent, the start positions of the chunk and the pattern length - 1 after them
+} chunkHeader_;
+#define CHUNK_HEADER_LONGS ((int) (sizeof(chunkHeader_) / sizeof(long long)))
+
+typedef struct foundRounds
+{ //running sequence of MPI_Iallreduce rounds telling every process whether any process has found the pattern
+	int localState[2]; //this process: found the pattern, still searching
+	int globalState[2]; //sum over all processes
+	MPI_Request request;
+} foundRounds_;
+
+typedef struct searchMetadata
+{ //everything the other processes need to know about a search before receiving its data, sent in one MPI_Bcast
+	long long existsEmptyFile; //1 if the search is skipped because a file is empty or the text is shorter than the pattern
+	long long typeOfRead;
+	long long textLength; //length of the whole text
+	long long patternLength;
+} searchMetadata_;
+#define SEARCH_METADATA_LONGS ((int) (sizeof(searchMetadata_) / sizeof(long long)))
+
+#define LARGE_COUNT_BLOCK (1 << 30) //elements in each block of a large-count datatype, see largeCountType
+
+typedef struct portionTransfer
+{ //arguments of the MPI_Ialltoallw that scatters the portions of a text, kept until it completes (see startPortionTransfer)
+	int *sendCounts;
+	int *recvCounts;
+	int *displacements; //always 0, the offsets are in the datatypes
+	MPI_Datatype *sendTypes;
+	MPI_Datatype *recvTypes;
+	long long unused; //buffer passed for the side of the exchange a process has nothing to send or receive on, all its counts are 0
+} portionTransfer_;
+
+typedef struct stagedSearch
+{ //a single search whose data is sent to the other processes ahead of time when pipeline is set
+	char typeOfRead;
+	char *textData; //the whole text on the master, the portion of text on the other processes
+	long long textLength;
+	bool textMapped;
+	char *patternData;
+	long long patternLength;
+	bool patternMapped;
+	long long startIndex;
+	long long lastOwnedStart;
+	int entry; //control entry being staged, on the master
+	MPI_File textFile; //text being read with MPI_File_iread_at while the current search runs, on the master
+	MPI_Request textRead;
+	double readPosted; //when the read of the text was started
+	double loadSeconds; //time the master spent reading the text and pattern instead of searching
+	double overlapSeconds; //time the text was being read while the master searched the current text
+	searchMetadata_ metadata;
+	portionTransfer_ transfer; //the scatter of the portions of text
+	MPI_Request requests[3]; //metadata, pattern and text transfers still running
+	int numRequests;
+} stagedSearch_;
+
+stagedSearch_ stagedSearches[2]; //the search being carried out and the one being sent ahead of it
+MPI_Comm stagingComm; //copy of MPI_COMM_WORLD for the staged transfers, so they do not have to be ordered with the collectives of the current search
+portionTransfer_ textTransfer; //arguments of the scatter of the current search's portions, see startPortionTransfer
+
+bool metricsEnabled = false; //set by --metrics, one line of phase timings is written per control entry
+FILE *metricsFile = NULL; //metrics_MPI.csv on the master, see metrics.h
+searchMetrics_ metrics; //phase timings of the current search on this process
+double *rankSearchTime = NULL; //search time of every process, gathered by the master for the metrics
+
+searchEngineType_ engineType = ENGINE_NAIVE; //search engine to use, chosen with the --engine= command line option
+searchEngine_ engine; //engine prepared from the current pattern by each process
 
 void generateOutputFile() 
 { //This method will generate the output file to store results
@@ -111,446 +315,2675 @@ void generateOutputFile()
 	outputFile = fopen(fileName, "w");
 }
 
-void insertLineInFile(int result) 
+void insertLineInFile(long long result) 
 { //This method will insert a line in the output file in the format textFile patternFile result
     fputs(textNumber, outputFile);
     fputc(' ', outputFile);
     fputs(patternNumber, outputFile);
     fputc(' ', outputFile);
-    fprintf(outputFile, "%d", result);
+    fprintf(outputFile, "%lld", result);
     fputc('\n', outputFile);
 }
 
-/*
-This method will remove all duplicate values from the unsorted linked list.
-Before removeDuplicates:
-4-->32-->32-->8-->9-->32-->8
-After removeDuplicates:
-4-->32-->8-->9
-I took this removeDuplicates method from the following resource:
-https://www.geeksforgeeks.org/remove-duplicates-from-an-unsorted-linked-list/
-The author is listed as Gaurav Saxena.
-*/
-void removeDuplicates(linkedList_* start)
-{
-    linkedList_ *ptr1, *ptr2, *dup;
-    ptr1 = start;
- 
-    while (ptr1->index != -1 && ptr1->next != NULL) {
-        ptr2 = ptr1;
-
-        while (ptr2->next != NULL) {
-            if (ptr1->index == ptr2->next->index) {
-                ptr2->next = ptr2->next->next;
-                free (dup);
-            }
-            else
-                ptr2 = ptr2->next;
-        }
-        ptr1 = ptr1->next;
-    }
-}
-
 //standard method taken from searching_sequential.c from Blesson
-void outOfMemory(int amount)
+void outOfMemory(long long amount)
 {
-	printf("Tried to allocate %d\n", amount);
+	printf("Tried to allocate %lld\n", amount);
 	fprintf (stderr, "Out of memory\n");
 	//MPI_Finalize(); 
 	exit (0);
 }
 
-//standard method taken from searching_sequential.c from Blesson
-void readFromFile (FILE *f, char **data, int *length)
-{
-	int ch;
-	int allocatedLength;
-	char *result;
-	int resultLength = 0;
+void pushPosition(positionList_ *list, long long value)
+{ //This method will add a value to the end of the list, doubling its size when it is full
+	if (list->count == list->allocated)
+	{
+		list->allocated = list->allocated > 0 ? list->allocated * 2 : 1024;
+		list->positions = (long long *) realloc(list->positions, sizeof(long long) * list->allocated);
+		if (list->positions == NULL)
+			outOfMemory(list->allocated);
+	}
+	list->positions[list->count++] = value;
+}
 
-	allocatedLength = 0;
-	result = NULL;
+void freePositions(positionList_ *list)
+{ //This method releases the memory held by a list and leaves it empty
+	free(list->positions);
+	list->positions = NULL;
+	list->count = 0;
+	list->allocated = 0;
+}
 
-	ch = fgetc (f);
-	while (ch >= 0)
+/*
+This method makes room in list for count more positions
+*/
+void reservePositions(positionList_ *list, long long count)
+{
+	if (list->count + count > list->allocated)
 	{
-		resultLength++;
-		if (resultLength > allocatedLength)
-		{
-			allocatedLength += 10000;
-			result = (char *) realloc (result, sizeof(char)*allocatedLength);
-			if (result == NULL)
-				outOfMemory(allocatedLength);
-		}
-		result[resultLength-1] = ch;
-		ch = fgetc(f);
+		list->allocated = list->count + count;
+		list->positions = (long long *) realloc(list->positions, sizeof(long long) * (list->allocated > 0 ? list->allocated : 1));
+		if (list->positions == NULL)
+			outOfMemory(list->allocated);
 	}
-	*data = result;
-	*length = resultLength;
 }
 
-//standard method taken from searching_sequential.c from Blesson
-int readData ()
+/*
+This method reads the whole of an open file into a heap buffer. It used to be the fgetc loop from
+searching_sequential.c, it now reads the file in large blocks (see readFileBuffered in text_io.h).
+It is used for the control file, which is tokenised in place so needs a writable copy, and as the
+fallback for text and pattern files that can not be mapped.
+*/
+void readFromFile (FILE *f, char **data, long long *length)
+{
+	if (!readFileBuffered(f, data, length))
+		outOfMemory(*length);
+}
+
+/*
+This method loads a text or pattern file, mapping it into memory if possible and otherwise reading
+it into a buffer. isMapped records which was done so that releaseData frees it the right way.
+Returns 0 if the file could not be opened.
+*/
+int loadFile (char *fileName, char **data, long long *length, bool *isMapped)
 {
 	FILE *f;
+	*isMapped = mapFile(fileName, data, length);
+	if (*isMapped)
+		return 1;
+
+	f = fopen (fileName, "r");
+	if (f == NULL)
+		return 0;
+	readFromFile (f, data, length);
+	fclose (f);
+	return 1;
+}
+
+/*
+This method loads text file number into data
+*/
+int readText (char *number, char **data, long long *length, bool *isMapped)
+{
 	char fileName[1000];
 #ifdef DOS
         sprintf (fileName, "inputs\\test%d\\text.txt", testNumber);
 #else
-	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	sprintf (fileName, "large_inputs/text%s.txt", number);
 #endif
-	f = fopen (fileName, "r");
-	if (f == NULL) {
+	if (!loadFile (fileName, data, length, isMapped))
+	{ //a missing text is treated as empty so the search is skipped
+		*data = NULL;
+		*length = 0;
+		*isMapped = false;
 		return 0;
 	}
-	readFromFile (f, &textData, &textLength);
-	fclose (f);
+	return 1;
+}
+
+/*
+This method loads pattern file number into data
+*/
+int readPattern (char *number, char **data, long long *length, bool *isMapped)
+{
+	char fileName[1000];
 #ifdef DOS
         sprintf (fileName, "inputs\\test%d\\pattern.txt", testNumber);
 #else
-	sprintf (fileName, "large_inputs/pattern%s.txt", patternNumber);
+	sprintf (fileName, "large_inputs/pattern%s.txt", number);
 #endif
-	f = fopen (fileName, "r");
-	if (f == NULL) {
+	if (!loadFile (fileName, data, length, isMapped))
+	{ //a missing pattern is treated as empty so it is reported as not found
+		*data = NULL;
+		*length = 0;
+		*isMapped = false;
 		return 0;
 	}
-	readFromFile (f, &patternData, &patternLength);
-	fclose (f);
+	return 1;
+}
+
+/*
+This method prints how quickly the data for a search was loaded, and records the time in the metrics
+*/
+void reportLoadThroughput (double loadStart, double bytesLoaded)
+{
+	double loadTime = MPI_Wtime() - loadStart;
+	metrics.loadSeconds = loadTime;
+	double megabytes = bytesLoaded / (1024.0 * 1024.0);
+	printf ("Loaded %.2f MB in %f seconds (%.1f MB/s)%s\n", megabytes, loadTime,
+		loadTime > 0 ? megabytes / loadTime : 0.0, textMapped ? " using mmap" : "");
+}
 
+//standard method taken from searching_sequential.c from Blesson
+int readData ()
+{
+	double loadStart = MPI_Wtime();
+	if (!readText (textNumber, &textData, &textLength, &textMapped))
+		return 0;
+	if (!readPattern (patternNumber, &patternData, &patternLength, &patternMapped))
+		return 0;
+
+	//report how quickly the text and pattern were loaded
+	reportLoadThroughput (loadStart, textLength + (double) patternLength);
 	return 1;
 }
 
+/*
+This method releases the text and pattern loaded by readData
+*/
+void releaseData ()
+{
+	releaseFile(textData, textLength, textMapped);
+	releaseFile(patternData, patternLength, patternMapped);
+	textData = NULL;
+	patternData = NULL;
+	textMapped = false;
+	patternMapped = false;
+}
+
+
+/*
+This method returns the last start position this process should search in its textData. Each start
+position belongs to exactly one process (see lastOwnedPosition), so a match in the overlap between two
+portions is only reported by the process it starts in.
+*/
+long long lastSearchPosition()
+{
+	long long lastI = textLength-patternLength;
+	if (lastOwnedStart < lastI)
+	{ //the rest of the text held by this process is the overlap with the next portion
+		lastI = lastOwnedStart;
+	}
+	return lastI;
+}
+
+/*
+Returns the OpenMP thread number of the caller, or 0 in the MPI only build
+*/
+int currentThread()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+/*
+This method is a modified version of the original hostMatch, it allows the processes to store
+all positions at which they find a pattern match in an array in ascending order, which is later
+reduced into a single sorted array in the master process. This method is only used when the search type is 
+a '1' ie. When all occurances of a pattern need to be found. The search is done by the engine
+chosen with --engine= (see search_engines.h).
+In the hybrid build (-fopenmp) the portion is split into blocks searched by threadsPerRank threads. Each
+thread records its matches in its own array and the blocks are concatenated in order at the end, as in
+project_OMP.c. In the MPI only build the pragmas are ignored and the loop runs on one thread.
+*/
+positionList_ hostMatchFindAll()
+{
+	int block, numBlocks;
+	long long lastI;
+    positionList_ foundAtList = {NULL, 0, 0};
+	positionList_ *threadResults = (positionList_ *) calloc(threadsPerRank, sizeof(positionList_)); //one array of matches per thread
+
+	lastI = lastSearchPosition();
+	numBlocks = (int) (lastI / SEARCH_BLOCK_SIZE + 1);
+	int *blockThread = (int *) malloc(sizeof(int) * numBlocks); //thread that searched each block
+	long long *blockStart = (long long *) malloc(sizeof(long long) * numBlocks); //where the block's matches start in that thread's array
+	long long *blockCount = (long long *) malloc(sizeof(long long) * numBlocks); //number of matches in the block
+	if (threadResults == NULL || blockThread == NULL || blockStart == NULL || blockCount == NULL)
+		outOfMemory(numBlocks);
+
+#ifdef _OPENMP
+	#pragma omp parallel for shared(threadResults, blockThread, blockStart, blockCount, engine) firstprivate(lastI, textData) private(block) num_threads(threadsPerRank) schedule(guided)
+#endif
+	for (block = 0; block < numBlocks; block++)
+	{
+		long long startPos;
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		positionList_ *myResults = &threadResults[currentThread()];
+		searchCursor_ cursor;
+		if (lastPos > lastI)
+		{ //the last block stops at the last position this process searches
+			lastPos = lastI;
+		}
+
+		blockThread[block] = currentThread();
+		blockStart[block] = myResults->count;
+		startSearchCursor(&cursor, firstPos);
+		while ((startPos = searchEngineNext(&engine, textData, lastPos, &cursor)) != -1)
+		{ //when a pattern is found, push the result to this thread's list, only the count is printed in reduceResults
+			pushPosition(myResults, startPos);
+		}
+		blockCount[block] = myResults->count - blockStart[block];
+	}
+
+	//concatenate the blocks in order, the engines find positions in order within a block
+	for (block = 0; block < numBlocks; block++)
+		foundAtList.count += blockCount[block];
+	foundAtList.allocated = foundAtList.count;
+	if (foundAtList.count > 0)
+	{
+		long long offset = 0;
+		foundAtList.positions = (long long *) malloc(sizeof(long long) * foundAtList.count);
+		if (foundAtList.positions == NULL)
+			outOfMemory(foundAtList.count);
+		for (block = 0; block < numBlocks; block++)
+		{
+			memcpy(foundAtList.positions + offset, threadResults[blockThread[block]].positions + blockStart[block], sizeof(long long) * blockCount[block]);
+			offset += blockCount[block];
+		}
+	}
+	numPatternsFound = foundAtList.count;
+
+	for (int t = 0; t < threadsPerRank; t++)
+		freePositions(&threadResults[t]);
+	free(threadResults);
+	free(blockThread);
+	free(blockStart);
+	free(blockCount);
+	return foundAtList;
+}
+
+/*
+This method searches blocks firstBlock to endBlock - 1 of this process's portion for the pattern and
+returns -2 if it is found or -1 if not. In the hybrid build the blocks are shared between threadsPerRank
+threads, and the first thread to find the pattern sets isFound with an atomic store so the others skip
+their remaining blocks.
+*/
+int searchBlocksForPattern(int firstBlock, int endBlock, long long lastI)
+{
+	int block, isFound;
+	isFound = -1;
+
+#ifdef _OPENMP
+	#pragma omp parallel for shared(isFound, engine) firstprivate(lastI, textData) private(block) num_threads(threadsPerRank) schedule(static)
+#endif
+	for (block = firstBlock; block < endBlock; block++)
+	{
+		int found;
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		searchCursor_ cursor;
+		if (lastPos > lastI)
+		{
+			lastPos = lastI;
+		}
+
+#ifdef _OPENMP
+		#pragma omp atomic read acquire
+#endif
+		found = isFound;
+		if (found == -1)
+		{ //blocks are skipped once any thread has found the pattern
+			startSearchCursor(&cursor, firstPos);
+			if (searchEngineNext(&engine, textData, lastPos, &cursor) != -1)
+			{
+#ifdef _OPENMP
+				#pragma omp atomic write release
+#endif
+				isFound = -2;
+			}
+		}
+	}
+	return isFound;
+}
+
+/*
+This method counts the positions in this process's portion at which the pattern is found, without storing
+them. In the hybrid build the blocks are shared between threadsPerRank threads and their counts are summed
+with an OpenMP reduction. This method is only used when the search type is '2'.
+*/
+long long hostMatchCount()
+{
+	int block, numBlocks;
+	long long lastI, count;
+
+	count = 0;
+	lastI = lastSearchPosition();
+	numBlocks = (int) (lastI / SEARCH_BLOCK_SIZE + 1);
+
+#ifdef _OPENMP
+	#pragma omp parallel for shared(engine) firstprivate(lastI, textData) private(block) reduction(+:count) num_threads(threadsPerRank) schedule(static)
+#endif
+	for (block = 0; block < numBlocks; block++)
+	{
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		searchCursor_ cursor;
+		if (lastPos > lastI)
+		{
+			lastPos = lastI;
+		}
+
+		startSearchCursor(&cursor, firstPos);
+		while (searchEngineNext(&engine, textData, lastPos, &cursor) != -1)
+			count++;
+	}
+	return count;
+}
+
+/*
+This method starts the first found round of a type '0' search
+*/
+void startFoundRounds(foundRounds_ *rounds, bool searching)
+{
+	rounds->localState[0] = 0;
+	rounds->localState[1] = searching;
+	MPI_Iallreduce(rounds->localState, rounds->globalState, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD, &rounds->request);
+}
+
+/*
+This method is called after each step of a type '0' search. While this process is still searching it
+only tests the running round, otherwise it waits for it. When a round completes it returns true if any
+process found the pattern or no process is still searching, or starts the next round with this
+process's state. Every process gets the same sums, so they all return true on the same round.
+*/
+bool foundRoundsFinished(foundRounds_ *rounds, int isFound, bool searching)
+{
+	int completed;
+	if (searching)
+	{ //only check on the other processes, keep searching if they have not all reported yet
+		MPI_Test(&rounds->request, &completed, MPI_STATUS_IGNORE);
+	} else
+	{ //nothing left to search, wait for the answer
+		MPI_Wait(&rounds->request, MPI_STATUS_IGNORE);
+		completed = 1;
+	}
+
+	if (completed)
+	{
+		if (rounds->globalState[0] > 0 || rounds->globalState[1] == 0)
+		{ //some process has found the pattern, or every process has finished its portion
+			return true;
+		}
+		rounds->localState[0] = isFound == -2;
+		rounds->localState[1] = searching;
+		MPI_Iallreduce(rounds->localState, rounds->globalState, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD, &rounds->request);
+	}
+	return false;
+}
+
+/*
+This method is very similar to the original hostMatch, except each process searches only their
+allocated portion of the fill text. This method is only used when the search type is 
+a '0' ie. When finding if a pattern exists in the text.
+The portion is searched threadsPerRank blocks at a time, and between each step the process checks whether
+any process has found the pattern yet, so every process stops soon after the first hit rather than
+finishing its whole portion. The check is a running sequence of nonblocking MPI_Iallreduce rounds that sum
+{found anywhere, still searching}. A new round is started as soon as the last one completes, and
+MPI_Test is used while searching so the search never waits on the other processes. Every process gets
+the same sums from every round, so they all stop on the same round: the first one in which any process
+reports a hit, or in which no process is still searching. The result is still combined in reduceResults.
+A process with nothing to search (skipSearch) still has to take part in the rounds until they finish.
+*/
+int hostMatchFindExists(bool skipSearch)
+{
+	int numBlocks, isFound, nextBlock;
+	long long lastI;
+	foundRounds_ rounds;
+
+	isFound = -1;
+	nextBlock = 0;
+	lastI = lastSearchPosition();
+	numBlocks = skipSearch ? 0 : (int) (lastI / SEARCH_BLOCK_SIZE + 1);
+
+	startFoundRounds(&rounds, numBlocks > 0);
+	while (true)
+	{
+		if (isFound == -1 && nextBlock < numBlocks)
+		{ //search the next threadsPerRank blocks
+			int endBlock = nextBlock + threadsPerRank;
+			if (endBlock > numBlocks)
+			{
+				endBlock = numBlocks;
+			}
+			isFound = searchBlocksForPattern(nextBlock, endBlock, lastI);
+			nextBlock = endBlock;
+		}
+
+		bool searching = isFound == -1 && nextBlock < numBlocks;
+		if (foundRoundsFinished(&rounds, isFound, searching))
+			break;
+	}
+
+	if (nextBlock < numBlocks)
+	{
+		printf("process %d stopped early after searching %d of %d blocks\n", worldRank, nextBlock, numBlocks);
+	}
+	return isFound;
+}
+
+/*
+Checks to see if either of the files are empty, or if the text file is shorter than the pattern file
+In all of these cases the pattern will never be found, so the program will skip the search
+*/
+bool checkForEmptyFiles() 
+{
+    if (textLength == 0 || patternLength == 0 || textLength < patternLength)
+    { //pattern will not be found if text or pattern file is empty, or if the pattern is longer than the text
+		if(worldRank == 0) 
+		{ //master prints that search is being skipped
+			printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
+		}
+        return true;
+    }
+    return false;
+}
+
+/*
+This method will call the hostMatchFindAll method which will return an array of all of the occurances
+that this process finds
+*/
+positionList_ processDataFindAll()
+{
+	positionList_ allOccurances = {NULL, 0, 0};
+    if (checkForEmptyFiles())
+    { //skip the search if there is an empty file of if the text is shorter than the pattern
+        return allOccurances;
+    }
+
+    double phaseStart = MPI_Wtime();
+    prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+    metrics.prepareSeconds = MPI_Wtime() - phaseStart;
+    phaseStart = MPI_Wtime();
+    allOccurances = hostMatchFindAll();
+    metrics.searchSeconds = MPI_Wtime() - phaseStart;
+
+	return allOccurances;
+}
+
+/*
+This method will call the hostMatchCount method which will return the number of occurances that this
+process finds
+*/
+long long processDataCount()
+{
+    if (checkForEmptyFiles())
+    { //skip the search if there is an empty file of if the text is shorter than the pattern
+        return 0;
+    }
+
+    double phaseStart = MPI_Wtime();
+    prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+    metrics.prepareSeconds = MPI_Wtime() - phaseStart;
+    phaseStart = MPI_Wtime();
+    long long count = hostMatchCount();
+    metrics.searchSeconds = MPI_Wtime() - phaseStart;
+    return count;
+}
+
+/*
+This method will return -1 if a pattern does not exist in the text and -2 if it does.
+*/
+int processDataFindExists()
+{
+    int result;
+    double phaseStart = MPI_Wtime();
+    if (checkForEmptyFiles())
+    { //skip the search if there is an empty file of if the text is shorter than the pattern
+        //every process still joins the early termination checks in hostMatchFindExists
+        result = hostMatchFindExists(true);
+        metrics.searchSeconds = MPI_Wtime() - phaseStart;
+        return result;
+    }
+
+    //return -2 if pattern is found or -1 if pattern is not found
+    prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+    metrics.prepareSeconds = MPI_Wtime() - phaseStart;
+    phaseStart = MPI_Wtime();
+    result = hostMatchFindExists(false);
+    metrics.searchSeconds = MPI_Wtime() - phaseStart;
+    return result;
+}
+
+/*
+This method builds a datatype covering count elements of element, starting displacement bytes into a
+buffer. MPI counts are int, so anything over INT_MAX elements (a text over 2GB) can not be given as a
+count directly. The datatype is made of as many blocks of LARGE_COUNT_BLOCK elements as fit, followed by
+the remainder, so any 64-bit count can be sent with a count of 1. The caller frees it with MPI_Type_free.
+*/
+MPI_Datatype largeCountType(long long count, MPI_Datatype element, MPI_Aint displacement)
+{
+	MPI_Datatype block, result;
+	MPI_Datatype parts[2];
+	int lengths[2];
+	MPI_Aint displacements[2], lowerBound, extent;
+
+	MPI_Type_get_extent(element, &lowerBound, &extent);
+	MPI_Type_contiguous(LARGE_COUNT_BLOCK, element, &block);
+	lengths[0] = (int) (count / LARGE_COUNT_BLOCK);
+	lengths[1] = (int) (count % LARGE_COUNT_BLOCK);
+	parts[0] = block;
+	parts[1] = element;
+	displacements[0] = displacement;
+	displacements[1] = displacement + (MPI_Aint) lengths[0] * LARGE_COUNT_BLOCK * extent;
+	MPI_Type_create_struct(2, lengths, displacements, parts, &result);
+	MPI_Type_commit(&result);
+	MPI_Type_free(&block);
+	return result;
+}
+
+/*
+This method broadcasts count elements of element from the master, for any 64-bit count
+*/
+void broadcastLarge(void *buffer, long long count, MPI_Datatype element, MPI_Comm comm)
+{
+	MPI_Datatype type = largeCountType(count, element, 0);
+	MPI_Bcast(buffer, 1, type, 0, comm);
+	MPI_Type_free(&type);
+}
+
+/*
+This method starts a nonblocking broadcast of count elements of element from the master, for any
+64-bit count. The datatype can be freed straight away, the broadcast still completes normally.
+*/
+void startBroadcastLarge(void *buffer, long long count, MPI_Datatype element, MPI_Comm comm, MPI_Request *request)
+{
+	MPI_Datatype type = largeCountType(count, element, 0);
+	MPI_Ibcast(buffer, 1, type, 0, comm, request);
+	MPI_Type_free(&type);
+}
+
+/*
+This method returns the last start position, in the full text, that belongs to process rank. Process rank
+owns the start positions from jump * rank up to the start of the next process's portion, and the last
+process owns everything to the end of the text.
+*/
+long long lastOwnedPosition(long long fullTextLength, int rank)
+{
+	if (rank == worldSize - 1)
+		return fullTextLength - 1;
+	return (fullTextLength / worldSize) * (rank + 1) - 1;
+}
+
+/*
+This method works out the portion [start, end) of a text of length fullTextLength that is held by
+process rank. Each portion carries on haloLength characters past the last start position it owns, so
+a match starting there is not cut off, and the last portion runs to the end of the text. A halo of the
+pattern length - 1 is enough.
+*/
+void portionBounds(long long fullTextLength, long long haloLength, int rank, long long *start, long long *end)
+{
+	long long jump = fullTextLength / worldSize;
+	*start = jump * rank;
+	*end = *start + jump + haloLength;
+	if (rank == worldSize - 1 || *end > fullTextLength)
+	{ //set end index to the text length for the last process, or if the endIndex exceeds the text length
+		*end = fullTextLength;
+	}
+}
+
+/*
+This method allocates the arguments of a portion transfer, one slot per process
+*/
+void initPortionTransfer(portionTransfer_ *transfer)
+{
+	transfer->sendCounts = (int *) calloc(worldSize, sizeof(int));
+	transfer->recvCounts = (int *) calloc(worldSize, sizeof(int));
+	transfer->displacements = (int *) calloc(worldSize, sizeof(int));
+	transfer->sendTypes = (MPI_Datatype *) malloc(sizeof(MPI_Datatype) * worldSize);
+	transfer->recvTypes = (MPI_Datatype *) malloc(sizeof(MPI_Datatype) * worldSize);
+	if (transfer->sendCounts == NULL || transfer->recvCounts == NULL || transfer->displacements == NULL ||
+		transfer->sendTypes == NULL || transfer->recvTypes == NULL)
+		outOfMemory(worldSize);
+	for (int i = 0; i < worldSize; i++)
+	{
+		transfer->sendTypes[i] = MPI_CHAR;
+		transfer->recvTypes[i] = MPI_CHAR;
+	}
+}
+
+/*
+This method fills in one slot of a transfer with a large-count datatype for elements elements of element
+at displacement bytes. Empty slots are left with a count of 0, as MPI_Ialltoallw does not reliably match
+a count of 1 of an empty datatype.
+*/
+void setTransferSlot(int *count, MPI_Datatype *type, long long elements, MPI_Datatype element, MPI_Aint displacement)
+{
+	if (elements > 0)
+	{
+		*type = largeCountType(elements, element, displacement);
+		*count = 1;
+	}
+}
+
+/*
+This method starts sending every process its portion of the master's text of length fullTextLength, into
+portion on the other processes. MPI_Scatterv takes int counts and displacements, so it can not reach past
+2GB into a text. Instead each portion is described by a large-count datatype that holds its own 64-bit
+offset into the text (see largeCountType), and the portions are sent with one MPI_Ialltoallw in which only
+the master sends and only the other processes receive. The portions overlap by haloLength. The master keeps
+the whole text where it is. The datatypes are freed by finishPortionTransfer once the transfer completes.
+*/
+void startPortionTransfer(portionTransfer_ *transfer, char *text, long long fullTextLength, long long haloLength,
+	char *portion, MPI_Comm comm, MPI_Request *request)
+{
+	long long start, end;
+	//the side a process does not use has counts of 0 and its own buffer, so the send and receive buffers always differ
+	void *sendBuffer = &transfer->unused;
+	void *recvBuffer = &transfer->unused;
+	if (worldRank == 0)
+	{
+		for (int i = 1; i < worldSize; i++)
+		{
+			portionBounds(fullTextLength, haloLength, i, &start, &end);
+			setTransferSlot(&transfer->sendCounts[i], &transfer->sendTypes[i], end - start, MPI_CHAR, (MPI_Aint) start);
+		}
+		sendBuffer = text;
+	} else
+	{
+		portionBounds(fullTextLength, haloLength, worldRank, &start, &end);
+		setTransferSlot(&transfer->recvCounts[0], &transfer->recvTypes[0], end - start, MPI_CHAR, 0);
+		recvBuffer = portion;
+	}
+	MPI_Ialltoallw(sendBuffer, transfer->sendCounts, transfer->displacements, transfer->sendTypes,
+		recvBuffer, transfer->recvCounts, transfer->displacements, transfer->recvTypes, comm, request);
+}
+
+/*
+This method frees the datatypes of a completed portion transfer so its arguments can be used again
+*/
+void finishPortionTransfer(portionTransfer_ *transfer)
+{
+	for (int i = 0; i < worldSize; i++)
+	{
+		if (transfer->sendCounts[i] > 0)
+			MPI_Type_free(&transfer->sendTypes[i]);
+		if (transfer->recvCounts[i] > 0)
+			MPI_Type_free(&transfer->recvTypes[i]);
+		transfer->sendCounts[i] = 0;
+		transfer->recvCounts[i] = 0;
+		transfer->sendTypes[i] = MPI_CHAR;
+		transfer->recvTypes[i] = MPI_CHAR;
+	}
+}
+
+/*
+This method is used when sharedMemory is set to split the processes by node. The processes that can share
+memory with each other are found with MPI_Comm_split_type, and the first process on each node (the master
+on its own node) joins leaderComm, which is the only communicator the text is sent over.
+*/
+void initNodeComms()
+{
+	int numNodes = 0;
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, worldRank, MPI_INFO_NULL, &nodeComm);
+	MPI_Comm_rank(nodeComm, &nodeRank);
+	MPI_Comm_split(MPI_COMM_WORLD, nodeRank == 0 ? 0 : MPI_UNDEFINED, worldRank, &leaderComm);
+	if (leaderComm != MPI_COMM_NULL)
+		MPI_Comm_size(leaderComm, &numNodes);
+	if (worldRank == 0)
+		printf("Sharing one copy of each text between the processes on each of %d node(s)\n", numNodes);
+}
+
+/*
+This method is used in place of the scatter in scatterPortions when sharedMemory is set. Each node allocates
+one window with MPI_Win_allocate_shared covering the portions of every process on it, and the master sends
+each other node's leader that part of the text with a single message over leaderComm. Every process then
+searches its portion where it lies in the window, so a node holds the text once however many processes run
+on it, and nothing is copied between processes on the same node. The master searches its own text, so the
+window on its node only covers the portions of the other processes there, copied in by the master.
+The processes of a node are expected to have consecutive ranks, as they do with the usual block mapping,
+otherwise the window also covers the portions of the processes in between.
+*/
+void shareNodePortions(long long fullTextLength, long long haloLength)
+{
+	long long endIndex, span[2], nodeSpan[2], nodeStart, nodeLength;
+	MPI_Aint windowSize;
+	int displacementUnit;
+	char *window;
+
+	portionBounds(fullTextLength, haloLength, worldRank, &startIndex, &endIndex);
+	lastOwnedStart = lastOwnedPosition(fullTextLength, worldRank) - startIndex;
+	span[0] = worldRank == 0 ? LLONG_MAX : startIndex; //the node's first start index
+	span[1] = worldRank == 0 ? LLONG_MAX : -endIndex; //and last end index, negated so both are found with MPI_MIN
+	MPI_Allreduce(span, nodeSpan, 2, MPI_LONG_LONG, MPI_MIN, nodeComm);
+	nodeStart = nodeSpan[0] == LLONG_MAX ? 0 : nodeSpan[0];
+	nodeLength = nodeSpan[0] == LLONG_MAX ? 0 : -nodeSpan[1] - nodeSpan[0];
+
+	MPI_Win_allocate_shared(nodeRank == 0 ? (MPI_Aint) (nodeLength > 0 ? nodeLength : 1) : 0, 1, MPI_INFO_NULL, nodeComm, &window, &nodeWindow);
+	MPI_Win_shared_query(nodeWindow, 0, &windowSize, &displacementUnit, &window);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, nodeWindow);
+	if (leaderComm != MPI_COMM_NULL)
+	{ //the leaders fill in their node's window
+		long long mySpan[2] = {nodeStart, nodeLength};
+		long long *spans = NULL;
+		int numNodes;
+		MPI_Comm_size(leaderComm, &numNodes);
+		if (worldRank == 0)
+		{
+			spans = (long long *) malloc(sizeof(long long) * 2 * numNodes);
+			if (spans == NULL)
+				outOfMemory(numNodes);
+		}
+		MPI_Gather(mySpan, 2, MPI_LONG_LONG, spans, 2, MPI_LONG_LONG, 0, leaderComm);
+		if (worldRank == 0)
+		{
+			MPI_Request *requests = (MPI_Request *) malloc(sizeof(MPI_Request) * numNodes);
+			if (requests == NULL)
+				outOfMemory(numNodes);
+			requests[0] = MPI_REQUEST_NULL;
+			for (int node = 1; node < numNodes; node++)
+			{ //the node's part of the text can be over 2GB, see largeCountType
+				MPI_Datatype spanType = largeCountType(spans[2 * node + 1], MPI_CHAR, 0);
+				MPI_Isend(textData + spans[2 * node], 1, spanType, node, NODE_TEXT_TAG, leaderComm, &requests[node]);
+				MPI_Type_free(&spanType);
+			}
+			memcpy(window, textData + nodeStart, nodeLength);
+			MPI_Waitall(numNodes, requests, MPI_STATUSES_IGNORE);
+			free(requests);
+			free(spans);
+		} else
+		{
+			MPI_Datatype spanType = largeCountType(nodeLength, MPI_CHAR, 0);
+			MPI_Recv(window, 1, spanType, 0, NODE_TEXT_TAG, leaderComm, &status);
+			MPI_Type_free(&spanType);
+		}
+	}
+	//the rest of the node reads the window only once the leader has filled it
+	MPI_Win_sync(nodeWindow);
+	MPI_Barrier(nodeComm);
+	MPI_Win_sync(nodeWindow);
+
+	if (worldRank != 0)
+	{
+		ownText = textData;
+		textData = window + (startIndex - nodeStart);
+		textLength = endIndex - startIndex;
+	}
+}
+
+/*
+This method frees the node's window once the current search is done with it, giving the other processes
+their own text buffer back. It does nothing if the portions were not shared with shareNodePortions.
+*/
+void releaseNodePortions()
+{
+	if (nodeWindow == MPI_WIN_NULL)
+		return;
+	if (worldRank != 0)
+		textData = ownText;
+	ownText = NULL;
+	MPI_Win_unlock_all(nodeWindow);
+	MPI_Win_free(&nodeWindow);
+}
+
+/*
+This method sends every process its portion of the master's text with one collective (see
+startPortionTransfer). Sets startIndex, and textLength to the portion length on the other processes.
+*/
+void scatterPortions(long long fullTextLength, long long haloLength)
+{
+	long long endIndex;
+	MPI_Request request;
+
+	if (sharedMemory)
+	{ //processes on the same node share one copy of the text instead
+		shareNodePortions(fullTextLength, haloLength);
+		return;
+	}
+	portionBounds(fullTextLength, haloLength, worldRank, &startIndex, &endIndex);
+	lastOwnedStart = lastOwnedPosition(fullTextLength, worldRank) - startIndex;
+	if (worldRank != 0)
+	{
+		textLength = endIndex - startIndex;
+		textData = (char *)realloc(textData, sizeof(char) * (textLength > 0 ? textLength : 1)); //allocate memory for portion of text data
+		if (textData == NULL)
+			outOfMemory(textLength);
+	}
+	startPortionTransfer(&textTransfer, textData, fullTextLength, haloLength, textData, MPI_COMM_WORLD, &request);
+	MPI_Wait(&request, MPI_STATUS_IGNORE);
+	finishPortionTransfer(&textTransfer);
+}
+
+/*
+This method broadcasts the master's pattern of length length to every other process
+*/
+void broadcastPattern(long long length)
+{
+	if (worldRank != 0)
+	{
+		patternLength = length;
+		patternData = (char *)realloc(patternData, sizeof(char) * (patternLength > 0 ? patternLength : 1)); //allocate memory for the pattern
+		if (patternData == NULL)
+			outOfMemory(patternLength);
+	}
+	broadcastLarge(patternData, length, MPI_CHAR, MPI_COMM_WORLD);
+}
+
+/*
+This method will divide the text into portions and share them among the processes with collectives.
+The master reads the data and broadcasts the metadata of the search (whether it is skipped, the type
+of search and the lengths) as one searchMetadata_, then broadcasts the pattern and scatters the
+overlapping portions of text. Every process works out its own start index from the text length, so
+the cost of setting up a search grows with the log of the number of processes rather than linearly.
+*/
+void partitionTextData()
+{
+	searchMetadata_ metadata;
+	if (worldRank == 0) //master process reads the data and fills in the metadata
+	{
+		readData(); //read the pattern and text file and print their lengths
+        printf ("Text length = %lld\n", textLength);
+        printf ("Pattern length = %lld\n", patternLength);
+		metadata.existsEmptyFile = checkForEmptyFiles();
+		metadata.typeOfRead = typeOfRead;
+		metadata.textLength = textLength;
+		metadata.patternLength = patternLength;
+	}
+	MPI_Bcast(&metadata, SEARCH_METADATA_LONGS, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+	typeOfRead = (char) metadata.typeOfRead;
+	metrics.textBytes = metadata.textLength;
+	metrics.patternBytes = metadata.patternLength;
+
+	if (metadata.existsEmptyFile)
+	{ //if one of the files are empty, or if the text file is shorter than the pattern file, nothing else is sent
+		if (worldRank != 0)
+		{ //lengths of 0 so that search does not go ahead
+			textLength = 0;
+			patternLength = 0;
+		}
+		return;
+	}
+	broadcastPattern(metadata.patternLength);
+	if (dynamicChunks)
+	{ //the text is handed out a chunk at a time during the search, see dynamicMaster
+		textLength = metadata.textLength;
+		return;
+	}
+	scatterPortions(metadata.textLength, metadata.patternLength - 1);
+}
+
+/*
+This method is used by the master to find the size of text file textNumber without reading it.
+A missing text is treated as empty.
+*/
+long long textFileSize()
+{
+	char fileName[1000];
+	struct stat fileInfo;
+	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	if (stat(fileName, &fileInfo) != 0)
+		return 0;
+	return (long long) fileInfo.st_size;
+}
+
+/*
+This method broadcasts the current text number from the master so every process can open the text file
+*/
+void broadcastTextNumber()
+{
+	int numberLength = 0;
+	if (worldRank == 0)
+	{
+		strncpy(textNumberBuffer, textNumber, sizeof(textNumberBuffer) - 1);
+		numberLength = strlen(textNumberBuffer);
+	}
+	MPI_Bcast(&numberLength, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(textNumberBuffer, numberLength + 1, MPI_CHAR, 0, MPI_COMM_WORLD);
+	textNumber = textNumberBuffer;
+}
+
+/*
+This method is used when parallelIO is set. Every process, including the master, reads its own portion
+of the text file straight from disk with a collective MPI-IO read, so no process ever holds the whole
+text and nothing is copied through the master. The portions are worked out with portionBounds, exactly
+as in partitionTextData. Sets textData, textLength (to the portion length) and startIndex.
+*/
+void readPortionOfText(long long fullTextLength, long long haloLength)
+{
+	char fileName[1000];
+	MPI_File textFile;
+	MPI_Datatype portionType;
+	long long endIndex;
+
+	portionBounds(fullTextLength, haloLength, worldRank, &startIndex, &endIndex);
+	lastOwnedStart = lastOwnedPosition(fullTextLength, worldRank) - startIndex;
+	textLength = endIndex - startIndex;
+	textData = (char *)realloc(textData, sizeof(char) * (textLength > 0 ? textLength : 1)); //allocate memory for portion of text data
+	if (textData == NULL)
+		outOfMemory(textLength);
+
+	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	MPI_File_open(MPI_COMM_WORLD, fileName, MPI_MODE_RDONLY, MPI_INFO_NULL, &textFile);
+	portionType = largeCountType(textLength, MPI_CHAR, 0); //the portion can be over 2GB
+	MPI_File_read_at_all(textFile, (MPI_Offset) startIndex, textData, 1, portionType, &status);
+	MPI_Type_free(&portionType);
+	MPI_File_close(&textFile);
+}
+
+/*
+This method is the parallelIO version of partitionTextData. The master only reads the pattern and the
+size of the text, and broadcasts them along with the text number and type of search. Each process then
+reads its own portion of the text with readPortionOfText. It is also used when streamText is set, in
+which case textLength is left as the length of the whole text and nothing is read until the search.
+*/
+void partitionTextDataParallelIO()
+{
+	searchMetadata_ metadata;
+	if (worldRank == 0)
+	{
+		double loadStart = MPI_Wtime();
+		textLength = textFileSize();
+		readPattern (patternNumber, &patternData, &patternLength, &patternMapped);
+		reportLoadThroughput (loadStart, patternLength);
+        printf ("Text length = %lld\n", textLength);
+        printf ("Pattern length = %lld\n", patternLength);
+		metadata.typeOfRead = typeOfRead;
+		metadata.textLength = textLength;
+		metadata.patternLength = patternLength;
+	}
+	MPI_Bcast(&metadata, SEARCH_METADATA_LONGS, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+	textLength = metadata.textLength;
+	patternLength = metadata.patternLength;
+	typeOfRead = (char) metadata.typeOfRead;
+	metrics.textBytes = metadata.textLength;
+	metrics.patternBytes = metadata.patternLength;
+	if (checkForEmptyFiles())
+	{ //every process knows the lengths, so they all skip the search together
+		return;
+	}
+
+	broadcastPattern(patternLength);
+	broadcastTextNumber();
+	if (streamText)
+	{ //the text is read a chunk at a time during the search, see openTextStream
+		return;
+	}
+
+	double readStart = MPI_Wtime();
+	readPortionOfText(textLength, patternLength - 1);
+	printf("process %d read %lld bytes of text in %f seconds\n", worldRank, textLength, MPI_Wtime() - readStart);
+}
+
+/*
+This method sets up staging searches ahead of time when pipeline is set. The staged transfers use their
+own copy of the communicator, so they can be left running across the collectives of the current search.
+*/
+void initStagedSearches()
+{
+	MPI_Comm_dup(MPI_COMM_WORLD, &stagingComm);
+	for (int s = 0; s < 2; s++)
+	{
+		memset(&stagedSearches[s], 0, sizeof(stagedSearch_));
+		stagedSearches[s].textFile = MPI_FILE_NULL;
+		initPortionTransfer(&stagedSearches[s].transfer);
+	}
+}
+
+/*
+This method is used by the master when pipeline is set, just before it searches the current text. It reads
+the pattern of control entry entry and starts reading its text into stage with MPI_File_iread_at, so the
+read runs while the current text is searched. The metadata and pattern are sent with MPI_Ibcast straight
+away, the text is sent by sendStagedText once it has been read. If the text can not be opened it is read
+with readText instead, which treats a missing text as empty.
+*/
+void stageSearch(stagedSearch_ *stage, int entry)
+{
+	char fileName[1000];
+	MPI_Offset fileSize = 0;
+	double loadStart = MPI_Wtime();
+	stage->entry = entry;
+	stage->typeOfRead = controlEntries[entry].typeOfRead;
+	stage->textMapped = false;
+	stage->textRead = MPI_REQUEST_NULL;
+	stage->overlapSeconds = 0;
+	readPattern(controlEntries[entry].patternNumber, &stage->patternData, &stage->patternLength, &stage->patternMapped);
+	sprintf (fileName, "large_inputs/text%s.txt", controlEntries[entry].textNumber);
+	stage->textFile = MPI_FILE_NULL;
+	if (MPI_File_open(MPI_COMM_SELF, fileName, MPI_MODE_RDONLY, MPI_INFO_NULL, &stage->textFile) != MPI_SUCCESS ||
+		MPI_File_get_size(stage->textFile, &fileSize) != MPI_SUCCESS)
+	{ //fall back to reading the text now
+		if (stage->textFile != MPI_FILE_NULL)
+			MPI_File_close(&stage->textFile);
+		stage->textFile = MPI_FILE_NULL;
+		readText(controlEntries[entry].textNumber, &stage->textData, &stage->textLength, &stage->textMapped);
+	} else
+	{
+		stage->textLength = (long long) fileSize;
+		stage->textData = NULL;
+	}
+
+	stage->metadata.existsEmptyFile = stage->textLength == 0 || stage->patternLength == 0 || stage->textLength < stage->patternLength;
+	stage->metadata.typeOfRead = stage->typeOfRead;
+	stage->metadata.textLength = stage->textLength;
+	stage->metadata.patternLength = stage->patternLength;
+	stage->startIndex = 0;
+	stage->lastOwnedStart = lastOwnedPosition(stage->textLength, 0);
+	if (stage->textFile != MPI_FILE_NULL && !stage->metadata.existsEmptyFile)
+	{ //the text is only read if it is going to be searched
+		MPI_Datatype textType = largeCountType(stage->textLength, MPI_CHAR, 0); //the text can be over 2GB
+		stage->textData = (char *) malloc(sizeof(char) * stage->textLength);
+		if (stage->textData == NULL)
+			outOfMemory(stage->textLength);
+		MPI_File_iread_at(stage->textFile, 0, stage->textData, 1, textType, &stage->textRead);
+		MPI_Type_free(&textType);
+	}
+	stage->numRequests = 0;
+	MPI_Ibcast(&stage->metadata, SEARCH_METADATA_LONGS, MPI_LONG_LONG, 0, stagingComm, &stage->requests[stage->numRequests++]);
+	if (!stage->metadata.existsEmptyFile)
+	{ //nothing else is sent if the search is being skipped
+		startBroadcastLarge(stage->patternData, stage->patternLength, MPI_CHAR, stagingComm, &stage->requests[stage->numRequests++]);
+	}
+	stage->readPosted = MPI_Wtime();
+	stage->loadSeconds = stage->readPosted - loadStart;
+}
+
+/*
+This method is used by the master once it has searched the current text. It waits for the text started
+by stageSearch to finish reading and starts the same scatter of the portions as partitionTextData without
+waiting for it. The portions are scattered straight out of the read text, so it has to stay loaded until
+finishStagedSearch has waited for the transfers.
+*/
+void sendStagedText(stagedSearch_ *stage)
+{
+	double waitStart = MPI_Wtime();
+	if (stage->textRead != MPI_REQUEST_NULL)
+	{
+		stage->overlapSeconds = waitStart - stage->readPosted;
+		MPI_Wait(&stage->textRead, MPI_STATUS_IGNORE);
+	}
+	if (stage->textFile != MPI_FILE_NULL)
+		MPI_File_close(&stage->textFile);
+	stage->loadSeconds += MPI_Wtime() - waitStart;
+	printf ("Read text file %s and pattern file %s for the next search, %f seconds alongside the current search and %f seconds waiting for it\n",
+		controlEntries[stage->entry].textNumber, controlEntries[stage->entry].patternNumber, stage->overlapSeconds, stage->loadSeconds);
+	if (!stage->metadata.existsEmptyFile)
+	{
+		startPortionTransfer(&stage->transfer, stage->textData, stage->textLength, stage->patternLength - 1, NULL,
+			stagingComm, &stage->requests[stage->numRequests++]);
+	}
+}
+
+/*
+This method is used by the other processes to start receiving the metadata of the search the master is staging
+*/
+void receiveStagedMetadata(stagedSearch_ *stage)
+{
+	MPI_Ibcast(&stage->metadata, SEARCH_METADATA_LONGS, MPI_LONG_LONG, 0, stagingComm, &stage->requests[0]);
+	stage->numRequests = 1;
+}
+
+/*
+This method is used by the other processes once they have finished searching. It waits for the metadata
+of the staged search and starts receiving the pattern and the portion of text into the stage's own
+buffers, so they arrive while the results of the current search are being reduced.
+*/
+void receiveStagedData(stagedSearch_ *stage)
+{
+	long long endIndex;
+	MPI_Wait(&stage->requests[0], MPI_STATUS_IGNORE);
+	stage->numRequests = 0;
+	stage->typeOfRead = (char) stage->metadata.typeOfRead;
+	if (stage->metadata.existsEmptyFile)
+	{ //lengths of 0 so that search does not go ahead
+		stage->textLength = 0;
+		stage->patternLength = 0;
+		return;
+	}
+
+	portionBounds(stage->metadata.textLength, stage->metadata.patternLength - 1, worldRank, &stage->startIndex, &endIndex);
+	stage->lastOwnedStart = lastOwnedPosition(stage->metadata.textLength, worldRank) - stage->startIndex;
+	stage->textLength = endIndex - stage->startIndex;
+	stage->patternLength = stage->metadata.patternLength;
+	stage->textData = (char *)realloc(stage->textData, sizeof(char) * (stage->textLength > 0 ? stage->textLength : 1));
+	stage->patternData = (char *)realloc(stage->patternData, sizeof(char) * stage->patternLength);
+	if (stage->textData == NULL || stage->patternData == NULL)
+		outOfMemory(stage->textLength + stage->patternLength);
+	startBroadcastLarge(stage->patternData, stage->patternLength, MPI_CHAR, stagingComm, &stage->requests[stage->numRequests++]);
+	startPortionTransfer(&stage->transfer, NULL, stage->metadata.textLength, stage->patternLength - 1, stage->textData,
+		stagingComm, &stage->requests[stage->numRequests++]);
+}
+
+/*
+This method makes a staged search the current search, in place of distributeSearch. The other processes
+wait for their data to arrive and swap buffers with the stage. The master takes over the loaded text
+and pattern, leaving its transfers running until finishStagedSearch.
+*/
+void activateStagedSearch(stagedSearch_ *stage)
+{
+	typeOfRead = stage->typeOfRead;
+	textLength = stage->textLength;
+	patternLength = stage->patternLength;
+	startIndex = stage->startIndex;
+	lastOwnedStart = stage->lastOwnedStart;
+	metrics.textBytes = stage->metadata.textLength;
+	metrics.patternBytes = stage->metadata.patternLength;
+	if (worldRank == 0)
+	{
+		textData = stage->textData;
+		textMapped = stage->textMapped;
+		patternData = stage->patternData;
+		patternMapped = stage->patternMapped;
+		stage->textData = NULL;
+		stage->patternData = NULL;
+		printf ("Text length = %lld\n", textLength);
+		printf ("Pattern length = %lld\n", patternLength);
+	} else
+	{
+		char *swap;
+		MPI_Waitall(stage->numRequests, stage->requests, MPI_STATUSES_IGNORE);
+		stage->numRequests = 0;
+		finishPortionTransfer(&stage->transfer);
+		swap = textData;
+		textData = stage->textData;
+		stage->textData = swap;
+		swap = patternData;
+		patternData = stage->patternData;
+		stage->patternData = swap;
+	}
+}
+
+/*
+This method is used by the master to wait for the transfers of a staged search before its text is released
+*/
+void finishStagedSearch(stagedSearch_ *stage)
+{
+	MPI_Waitall(stage->numRequests, stage->requests, MPI_STATUSES_IGNORE);
+	stage->numRequests = 0;
+	finishPortionTransfer(&stage->transfer);
+}
+
+/*
+This method is used when streamText is set to start reading chunk into buffer. Each chunk is read
+together with the patternLength - 1 characters carried over into the next chunk, so a match spanning
+the boundary between two chunks is still found.
+*/
+void startChunkRead(textStream_ *stream, long long chunk, char *buffer)
+{
+	long long chunkStart = stream->firstStart + chunk * streamChunkSize;
+	long long chunkLast = chunkStart + streamChunkSize - 1;
+	MPI_Datatype chunkType;
+	if (chunkLast > stream->lastStart)
+	{
+		chunkLast = stream->lastStart;
+	}
+	chunkType = largeCountType(chunkLast - chunkStart + patternLength, MPI_CHAR, 0);
+	MPI_File_iread_at(stream->file, (MPI_Offset) chunkStart, buffer, 1, chunkType, &stream->read);
+	MPI_Type_free(&chunkType);
+}
+
+/*
+This method is used when streamText is set. It works out the start positions this process owns, as
+portionBounds and lastOwnedPosition do, opens the text on this process alone and starts reading the
+first chunk. The buffers are the only memory used for the text, two chunks of streamChunkSize +
+patternLength - 1 characters however large the text is.
+*/
+void openTextStream(textStream_ *stream)
+{
+	char fileName[1000];
+	size_t bufferSize = (size_t) streamChunkSize + patternLength - 1;
+
+	stream->firstStart = (textLength / worldSize) * worldRank;
+	stream->lastStart = lastOwnedPosition(textLength, worldRank);
+	if (stream->lastStart > textLength - patternLength)
+	{ //no match can start in the last patternLength - 1 characters
+		stream->lastStart = textLength - patternLength;
+	}
+	stream->numChunks = stream->lastStart < stream->firstStart ? 0 : (stream->lastStart - stream->firstStart) / streamChunkSize + 1;
+	stream->nextChunk = 0;
+	stream->read = MPI_REQUEST_NULL;
+	stream->savedText = textData;
+	stream->buffers[0] = (char *) malloc(sizeof(char) * bufferSize);
+	stream->buffers[1] = (char *) malloc(sizeof(char) * bufferSize);
+	if (stream->buffers[0] == NULL || stream->buffers[1] == NULL)
+		outOfMemory((long long) bufferSize);
+
+	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	MPI_File_open(MPI_COMM_SELF, fileName, MPI_MODE_RDONLY, MPI_INFO_NULL, &stream->file);
+	if (stream->numChunks > 0)
+	{
+		startChunkRead(stream, 0, stream->buffers[0]);
+	}
+}
+
+/*
+This method waits for the next chunk of the stream to arrive and makes it the text searched by
+hostMatchFindAll and searchBlocksForPattern, setting textData, textLength, startIndex and lastOwnedStart
+to the chunk. The chunk after it is read into the other buffer while this one is searched.
+Returns false once every chunk has been searched.
+*/
+bool nextStreamChunk(textStream_ *stream)
+{
+	long long chunk = stream->nextChunk;
+	if (chunk >= stream->numChunks)
+		return false;
+
+	MPI_Wait(&stream->read, MPI_STATUS_IGNORE);
+	textData = stream->buffers[chunk % 2];
+	startIndex = stream->firstStart + chunk * streamChunkSize;
+	lastOwnedStart = streamChunkSize - 1;
+	if (startIndex + lastOwnedStart > stream->lastStart)
+	{
+		lastOwnedStart = stream->lastStart - startIndex;
+	}
+	textLength = lastOwnedStart + patternLength;
+	if (chunk + 1 < stream->numChunks)
+	{
+		startChunkRead(stream, chunk + 1, stream->buffers[(chunk + 1) % 2]);
+	}
+	stream->nextChunk++;
+	return true;
+}
+
+/*
+This method waits for any read still running, closes the text and frees the buffers. textLength is
+set back to the length of the whole text and startIndex to 0, as positions are already converted.
+*/
+void closeTextStream(textStream_ *stream, long long fullTextLength)
+{
+	MPI_Wait(&stream->read, MPI_STATUS_IGNORE);
+	MPI_File_close(&stream->file);
+	free(stream->buffers[0]);
+	free(stream->buffers[1]);
+	textData = stream->savedText;
+	textLength = fullTextLength;
+	startIndex = 0;
+}
+
+/*
+This method finds every occurrence of the pattern in this process's share of the text, one chunk at a
+time with hostMatchFindAll, and returns them in ascending order as positions in the full text.
+*/
+positionList_ streamFindAll(textStream_ *stream)
+{
+	positionList_ foundAtList = {NULL, 0, 0};
+	while (nextStreamChunk(stream))
+	{
+		positionList_ chunkResults = hostMatchFindAll();
+		for (long long i = 0; i < chunkResults.count; i++)
+		{
+			pushPosition(&foundAtList, chunkResults.positions[i] + startIndex);
+		}
+		freePositions(&chunkResults);
+	}
+	numPatternsFound = foundAtList.count;
+	return foundAtList;
+}
+
+/*
+This method counts the occurrences of the pattern in this process's share of the text, one chunk at a
+time with hostMatchCount
+*/
+long long streamCount(textStream_ *stream)
+{
+	long long count = 0;
+	while (nextStreamChunk(stream))
+	{
+		count += hostMatchCount();
+	}
+	return count;
+}
+
+/*
+This method checks whether the pattern is in this process's share of the text one chunk at a time. It
+runs the same found rounds as hostMatchFindExists between chunks, so every process stops reading soon
+after any process finds the pattern.
+*/
+int streamFindExists(textStream_ *stream)
+{
+	int isFound = -1;
+	foundRounds_ rounds;
+
+	startFoundRounds(&rounds, stream->numChunks > 0);
+	while (true)
+	{
+		if (isFound == -1 && nextStreamChunk(stream))
+		{ //search every block of the chunk
+			long long lastI = lastSearchPosition();
+			isFound = searchBlocksForPattern(0, (int) (lastI / SEARCH_BLOCK_SIZE + 1), lastI);
+		}
+
+		bool searching = isFound == -1 && stream->nextChunk < stream->numChunks;
+		if (foundRoundsFinished(&rounds, isFound, searching))
+			break;
+	}
+
+	if (stream->nextChunk < stream->numChunks)
+	{
+		printf("process %d stopped early after searching %lld of %lld chunks\n", worldRank, stream->nextChunk, stream->numChunks);
+	}
+	return isFound;
+}
+
+/*
+This method is used in place of processDataFindExists and processDataFindAll when streamText is set.
+Every process knows the length of the whole text, so they all skip a search together, and otherwise
+each one streams its share of the text through a pair of chunk buffers. The time spent reading the
+chunks is counted as part of the search.
+*/
+void streamSearch()
+{
+	textStream_ stream;
+	long long fullTextLength = textLength;
+	if (checkForEmptyFiles())
+	{ //every process still joins the early termination checks of a type '0' search
+		if (typeOfRead == '0')
+			exists = hostMatchFindExists(true);
+		return;
+	}
+
+	double phaseStart = MPI_Wtime();
+	prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+	metrics.prepareSeconds = MPI_Wtime() - phaseStart;
+
+	phaseStart = MPI_Wtime();
+	openTextStream(&stream);
+	if (typeOfRead == '0')
+	{
+		exists = streamFindExists(&stream);
+	} else if (typeOfRead == '1')
+	{
+		foundAt = streamFindAll(&stream);
+	} else if (typeOfRead == '2')
+	{
+		numPatternsFound = streamCount(&stream);
+	}
+	closeTextStream(&stream, fullTextLength);
+	metrics.searchSeconds = MPI_Wtime() - phaseStart;
+}
+
+/*
+This method is the master's side of a --dynamic search. The text is cut into chunks of dynamicChunkSize
+start positions, and every other process is sent the next chunk, together with the patternLength - 1
+characters after it, each time it asks. A process asks again as soon as it has searched a chunk and
+sends its results with the request, so faster processes simply search more chunks. The chunks are sent
+straight out of the master's text without being copied. A type '0' search stops handing out chunks once
+any chunk has the pattern. The positions of each chunk are kept apart and laid end to end in chunk order
+at the end, so foundAt is already sorted and the master is the only process holding results.
+*/
+void dynamicMaster()
+{
+	long long lastI = textLength - patternLength;
+	long long numChunks = lastI / dynamicChunkSize + 1;
+	long long nextChunk = 0;
+	long long *searched = (long long *) calloc(worldSize, sizeof(long long)); //chunks searched by each process in this search
+	positionList_ *chunkResults = (positionList_ *) calloc(numChunks, sizeof(positionList_));
+	int busy = worldSize - 1;
+	if (searched == NULL || chunkResults == NULL)
+		outOfMemory(numChunks);
+
+	exists = -1;
+	while (busy > 0)
+	{
+		chunkRequest_ request;
+		chunkHeader_ header;
+		MPI_Recv(&request, CHUNK_REQUEST_LONGS, MPI_LONG_LONG, MPI_ANY_SOURCE, DYNAMIC_REQUEST_TAG, MPI_COMM_WORLD, &status);
+		int worker = status.MPI_SOURCE;
+		if (request.chunk >= 0)
+		{ //results of the chunk the process has just searched
+			searched[worker]++;
+			if (request.exists == -2)
+				exists = -2;
+			if (request.count > 0 && typeOfRead == '1')
+			{ //a type '2' search only sends the count, which the processes keep themselves
+				MPI_Datatype positionsType = largeCountType(request.count, MPI_LONG_LONG, 0);
+				reservePositions(&chunkResults[request.chunk], request.count);
+				MPI_Recv(chunkResults[request.chunk].positions, 1, positionsType, worker, DYNAMIC_POSITIONS_TAG, MPI_COMM_WORLD, &status);
+				MPI_Type_free(&positionsType);
+				chunkResults[request.chunk].count = request.count;
+			}
+		}
+
+		if (nextChunk < numChunks && exists == -1)
+		{ //send the next chunk and the characters a match starting in it can run on into
+			header.chunk = nextChunk;
+			header.start = nextChunk * dynamicChunkSize;
+			header.length = (header.start + dynamicChunkSize - 1 < lastI ? dynamicChunkSize : lastI - header.start + 1) + patternLength - 1;
+			MPI_Datatype chunkType = largeCountType(header.length, MPI_CHAR, 0);
+			MPI_Send(&header, CHUNK_HEADER_LONGS, MPI_LONG_LONG, worker, DYNAMIC_CHUNK_TAG, MPI_COMM_WORLD);
+			MPI_Send(textData + header.start, 1, chunkType, worker, DYNAMIC_TEXT_TAG, MPI_COMM_WORLD);
+			MPI_Type_free(&chunkType);
+			nextChunk++;
+		} else
+		{ //no chunks left, or the pattern has been found
+			header.chunk = -1;
+			MPI_Send(&header, CHUNK_HEADER_LONGS, MPI_LONG_LONG, worker, DYNAMIC_CHUNK_TAG, MPI_COMM_WORLD);
+			busy--;
+		}
+	}
+
+	//report how the chunks were shared out so slow processes stand out
+	printf("%lld of %lld chunks searched, by process:", nextChunk, numChunks);
+	for (int w = 1; w < worldSize; w++)
+	{
+		printf(" %d=%lld", w, searched[w]);
+		chunksSearched[w] += searched[w];
+	}
+	printf("\n");
+
+	for (long long chunk = 0; chunk < numChunks; chunk++)
+	{
+		for (long long i = 0; i < chunkResults[chunk].count; i++)
+			pushPosition(&foundAt, chunkResults[chunk].positions[i]);
+		freePositions(&chunkResults[chunk]);
+	}
+	free(chunkResults);
+	free(searched);
+}
+
+/*
+This method is the other processes' side of a --dynamic search. Each process asks the master for a chunk,
+searches it with searchBlocksForPattern or hostMatchFindAll as it would its portion, and asks for the next
+one with the results, until the master has no chunks left. The chunks are received into one buffer of
+dynamicChunkSize + patternLength - 1 characters.
+*/
+void dynamicWorker()
+{
+	chunkRequest_ request = {-1, -1, 0};
+	positionList_ chunkResults = {NULL, 0, 0};
+	char *savedText = textData;
+	char *buffer = (char *) malloc(sizeof(char) * ((size_t) dynamicChunkSize + patternLength - 1));
+	if (buffer == NULL)
+		outOfMemory((long long) dynamicChunkSize + patternLength - 1);
+
+	textData = buffer;
+	while (true)
+	{
+		chunkHeader_ header;
+		MPI_Send(&request, CHUNK_REQUEST_LONGS, MPI_LONG_LONG, 0, DYNAMIC_REQUEST_TAG, MPI_COMM_WORLD);
+		if (request.count > 0 && typeOfRead == '1')
+		{
+			MPI_Datatype positionsType = largeCountType(request.count, MPI_LONG_LONG, 0);
+			MPI_Send(chunkResults.positions, 1, positionsType, 0, DYNAMIC_POSITIONS_TAG, MPI_COMM_WORLD);
+			MPI_Type_free(&positionsType);
+		}
+		freePositions(&chunkResults);
+
+		MPI_Recv(&header, CHUNK_HEADER_LONGS, MPI_LONG_LONG, 0, DYNAMIC_CHUNK_TAG, MPI_COMM_WORLD, &status);
+		if (header.chunk < 0)
+			break;
+		MPI_Datatype chunkType = largeCountType(header.length, MPI_CHAR, 0);
+		MPI_Recv(buffer, 1, chunkType, 0, DYNAMIC_TEXT_TAG, MPI_COMM_WORLD, &status);
+		MPI_Type_free(&chunkType);
+
+		textLength = header.length;
+		lastOwnedStart = header.length - patternLength;
+		request.chunk = header.chunk;
+		request.exists = -1;
+		if (typeOfRead == '0')
+		{
+			long long lastI = lastSearchPosition();
+			request.exists = searchBlocksForPattern(0, (int) (lastI / SEARCH_BLOCK_SIZE + 1), lastI);
+		} else if (typeOfRead == '2')
+		{ //the count is summed with the other processes' in reduceResults
+			long long count = hostMatchCount();
+			numPatternsFound += count;
+			request.count = count;
+			continue;
+		} else
+		{ //positions are sent as positions in the full text
+			chunkResults = hostMatchFindAll();
+			for (long long i = 0; i < chunkResults.count; i++)
+				chunkResults.positions[i] += header.start;
+			numPatternsFound += chunkResults.count;
+		}
+		request.count = chunkResults.count;
+	}
+	free(buffer);
+	textData = savedText;
+}
+
+/*
+This method is used in place of processDataFindExists and processDataFindAll when dynamicChunks is set.
+Every process knows the lengths, so they all skip a search together, and otherwise the master hands out
+the text a chunk at a time with dynamicMaster. Positions are already in the full text, so startIndex is 0.
+*/
+void dynamicSearch()
+{
+	long long fullTextLength = textLength;
+	exists = -1;
+	startIndex = 0;
+	if (checkForEmptyFiles())
+		return;
+
+	double phaseStart = MPI_Wtime();
+	if (worldRank != 0)
+		prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+	metrics.prepareSeconds = MPI_Wtime() - phaseStart;
+
+	phaseStart = MPI_Wtime();
+	if (worldRank == 0)
+		dynamicMaster();
+	else
+		dynamicWorker();
+	textLength = fullTextLength;
+	metrics.searchSeconds = MPI_Wtime() - phaseStart;
+}
+
+/*
+This method will partition the data for the current search among the processes
+*/
+void distributeSearch()
+{
+    if (parallelIO || streamText)
+    {
+        partitionTextDataParallelIO();
+    } else
+    {
+        partitionTextData();
+    }
+}
+
+/*
+This method will carry out the current search on this process's portion of the text
+*/
+void doSearch() 
+{
+    if (streamText)
+    { //read and search this process's share of the text a chunk at a time
+        streamSearch();
+        return;
+    }
+    if (dynamicChunks)
+    { //the master hands out the text a chunk at a time
+        dynamicSearch();
+        return;
+    }
+    if (typeOfRead == '0') 
+    {
+        exists = processDataFindExists();
+    } else if (typeOfRead == '1')
+    {
+        foundAt = processDataFindAll();
+    } else if (typeOfRead == '2')
+    {
+        numPatternsFound = processDataCount();
+    }
+}
+
+
+/*
+This method collects every process's sorted positions into the master process with one collective
+straight into allResults. Every match is found by exactly one process and the portions are in text
+order, so the arrays laid end to end in rank order are already the sorted result. As with the portions
+of text, MPI_Gatherv can not address more than INT_MAX positions, so each process's array is described
+by a large-count datatype holding its 64-bit offset in allResults and the arrays are gathered with an
+MPI_Alltoallw in which every process only sends to the master.
+*/
+void gatherResults()
+{
+	long long *counts = NULL;
+	long long *gathered = NULL;
+	long long total = 0;
+	MPI_Request request;
+
+	if (worldRank == 0)
+	{
+		counts = (long long *) malloc(sizeof(long long) * worldSize);
+		if (counts == NULL)
+			outOfMemory(worldSize);
+	}
+	MPI_Gather(&foundAt.count, 1, MPI_LONG_LONG, counts, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+	if (worldRank == 0)
+	{
+		for (int i = 0; i < worldSize; i++)
+		{
+			setTransferSlot(&textTransfer.recvCounts[i], &textTransfer.recvTypes[i], counts[i], MPI_LONG_LONG, (MPI_Aint) (total * sizeof(long long)));
+			total += counts[i];
+		}
+		gathered = (long long *) malloc(sizeof(long long) * (total > 0 ? total : 1));
+		if (gathered == NULL)
+			outOfMemory(total);
+	}
+	setTransferSlot(&textTransfer.sendCounts[0], &textTransfer.sendTypes[0], foundAt.count, MPI_LONG_LONG, 0);
+	//only the master receives, the other processes have receive counts of 0 and pass the transfer's placeholder
+	MPI_Ialltoallw(foundAt.positions, textTransfer.sendCounts, textTransfer.displacements, textTransfer.sendTypes,
+		worldRank == 0 ? (void *) gathered : (void *) &textTransfer.unused, textTransfer.recvCounts, textTransfer.displacements,
+		textTransfer.recvTypes, MPI_COMM_WORLD, &request);
+	MPI_Wait(&request, MPI_STATUS_IGNORE);
+	finishPortionTransfer(&textTransfer);
+
+	if (worldRank == 0)
+	{ //the arrays arrive in rank order, which is already the order of the text
+		allResults.positions = gathered;
+		allResults.count = total;
+		allResults.allocated = total;
+		free(counts);
+	}
+}
+
+/*
+This method collects every process's sorted positions up a binary tree. At each step half of the
+remaining processes send their array to the partner holding the portions before theirs, which appends
+it to its own, so the master receives log2(worldSize) messages rather than one from every process.
+*/
+void treeMergeResults()
+{
+	positionList_ mine = foundAt;
+	foundAt.positions = NULL;
+	foundAt.count = 0;
+	foundAt.allocated = 0;
+
+	for (int step = 1; step < worldSize; step *= 2)
+	{
+		if (worldRank % (2 * step) == step)
+		{ //send everything collected so far to the partner and drop out
+			MPI_Datatype positionsType = largeCountType(mine.count, MPI_LONG_LONG, 0);
+			MPI_Send(&mine.count, 1, MPI_LONG_LONG, worldRank - step, 50, MPI_COMM_WORLD);
+			MPI_Send(mine.positions, 1, positionsType, worldRank - step, 60, MPI_COMM_WORLD);
+			MPI_Type_free(&positionsType);
+			break;
+		} else if (worldRank % (2 * step) == 0 && worldRank + step < worldSize)
+		{ //receive the partner's array onto the end of this one, its positions all come later in the text
+			long long count;
+			MPI_Datatype positionsType;
+			MPI_Recv(&count, 1, MPI_LONG_LONG, worldRank + step, 50, MPI_COMM_WORLD, &status);
+			reservePositions(&mine, count);
+			positionsType = largeCountType(count, MPI_LONG_LONG, 0);
+			MPI_Recv(mine.positions + mine.count, 1, positionsType, worldRank + step, 60, MPI_COMM_WORLD, &status);
+			MPI_Type_free(&positionsType);
+			mine.count += count;
+		}
+	}
+
+	if (worldRank == 0)
+	{
+		allResults = mine;
+	} else
+	{
+		freePositions(&mine);
+	}
+}
+
+/*
+This method will reduce the results back to the master process so it can print the results to the output file
+*/
+void reduceResults()
+{
+	if (typeOfRead == '0') 
+    { //if checking if a pattern exists in the text file, reduce the results to the minimum value found, which will be either -2 or -1
+		MPI_Reduce(&exists, &combinedResult, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD); 
+		if (worldRank == 0)
+		{
+			if(combinedResult == -1) 
+			{
+				printf("Pattern not found\n");
+			} else {
+				printf("Pattern found\n");
+			}
+		}
+    } else if (typeOfRead == '1')
+    { //if searching for all occurances of a pattern, reduce the results to a single sorted array in the master process
+		printf("process %d found %lld patterns\n", worldRank, numPatternsFound);
+		for (long long i = 0; i < foundAt.count; i++)
+		{ //convert this process's positions to positions in the full text
+			foundAt.positions[i] += startIndex;
+		}
+		if (worldSize >= TREE_MERGE_MIN_PROCESSES)
+		{
+			treeMergeResults();
+		} else
+		{
+			gatherResults();
+		}
+		freePositions(&foundAt);
+    } else if (typeOfRead == '2')
+    { //if only counting the occurances of a pattern, add up every process's count
+		printf("process %d found %lld patterns\n", worldRank, numPatternsFound);
+		MPI_Reduce(&numPatternsFound, &combinedCount, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+		if (worldRank == 0)
+		{
+			printf("# of patterns found = %lld\n", combinedCount);
+		}
+    }
+}
+
+/*
+This process will print the results of a single search to the output file. 
+*/
+void printResultsToFile() 
+{
+	if (worldRank == 0) 
+	{ //only the master process prints the results
+		if (typeOfRead == '0') 
+    	{ //only one line is needed when checking if the file exists
+			insertLineInFile(combinedResult);
+		} else if (typeOfRead == '2')
+		{ //or when counting the occurances
+			insertLineInFile(combinedCount);
+		} else 
+		{ //if search is finding all appearances of the pattern, then iterate through the sorted
+		  //array that is storing all the results and print each result to the output file.
+			if(allResults.count == 0) 
+			{
+				insertLineInFile(-1);
+			}
+			for (long long i = 0; i < allResults.count; i++) 
+			{
+				insertLineInFile(allResults.positions[i]);
+			}
+			freePositions(&allResults);
+		}
+	}
+	
+}
+
+/*
+This method starts the metrics of a search of groupSize control entries
+*/
+void startMetrics(int groupSize)
+{
+	memset(&metrics, 0, sizeof(searchMetrics_));
+	metrics.groupSize = groupSize;
+}
+
+/*
+This method is called by every process after each control entry when --metrics was given. The master
+gathers every process's search time and writes the metrics of the entry to metrics_MPI.csv.
+*/
+void recordMetrics()
+{
+	if (!metricsEnabled)
+		return;
+	MPI_Gather(&metrics.searchSeconds, 1, MPI_DOUBLE, rankSearchTime, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	if (worldRank == 0 && metricsFile != NULL)
+	{
+		metrics.numWorkers = worldSize;
+		metrics.workerSearchSeconds = rankSearchTime;
+		writeMetrics(metricsFile, textNumber, patternNumber, typeOfRead, &metrics);
+	}
+}
+
+/*
+This method reduces the results of the current search to the master and writes them to the output
+file, timing both phases for the metrics
+*/
+void reduceAndPrintResults()
+{
+	double phaseStart = MPI_Wtime();
+	reduceResults();
+	metrics.gatherSeconds = MPI_Wtime() - phaseStart;
+	if (worldRank == 0)
+	{
+		metrics.matches = typeOfRead == '0' ? combinedResult == -2 : typeOfRead == '2' ? combinedCount : allResults.count;
+	}
+	phaseStart = MPI_Wtime();
+	printResultsToFile();
+	metrics.writeSeconds = MPI_Wtime() - phaseStart;
+	recordMetrics();
+}
+
+typedef struct groupSearch
+{ //results of one process searching its portion of text for a group of patterns at once, one slot per control entry
+	char *types; //type of search for each entry
+	int *keywordEntry; //entry that each keyword in the automaton belongs to
+	int *exists; //-2 if the entry's pattern has been found in this portion, otherwise -1
+	positionList_ *threadFoundAt; //positions found by each thread for each entry, indexed [thread * numEntries + entry]
+	positionList_ *foundAt; //every position the entry's pattern was found at in ascending order, for type '1' entries
+	long long *threadCounts; //matches counted by each thread for each type '2' entry, indexed like threadFoundAt
+	long long *counts; //matches of each type '2' entry in this portion, summed over the threads
+	int numEntries;
+	int numFindAll; //number of type '1' and '2' entries, these always need the full portion scanned
+	int remainingExists; //number of type '0' entries whose pattern has not been found yet
+} groupSearch_;
+
+/*
+This method is called by the automaton for every pattern occurrence found during a group search.
+It returns false once every entry in the group has its answer so the scan can stop early.
+*/
+bool recordGroupMatch(void *context, int keyword, long long startPos)
+{
+	groupSearch_ *results = (groupSearch_ *) context;
+	int entry = results->keywordEntry[keyword];
+	int remainingExists;
+	if (results->types[entry] == '1')
+	{ //each thread records matches in its own array for the entry
+		pushPosition(&results->threadFoundAt[currentThread() * results->numEntries + entry], startPos);
+	}
+	else if (results->types[entry] == '2')
+	{ //only counted, in the thread's own counter
+		results->threadCounts[currentThread() * results->numEntries + entry]++;
+	}
+	else
+	{ //type '0', the unlocked check lets threads skip the critical section once the pattern has been found
+		int exists;
+#ifdef _OPENMP
+		#pragma omp atomic read
+#endif
+		exists = results->exists[entry];
+		if (exists == -1)
+		{
+#ifdef _OPENMP
+			#pragma omp critical (found)
+#endif
+			{
+				if (results->exists[entry] == -1)
+				{ //only the first thread to find this pattern counts it
+#ifdef _OPENMP
+					#pragma omp atomic write
+#endif
+					results->exists[entry] = -2;
+#ifdef _OPENMP
+					#pragma omp atomic update
+#endif
+					results->remainingExists--;
+				}
+			}
+		}
+	}
+#ifdef _OPENMP
+	#pragma omp atomic read acquire
+#endif
+	remainingExists = results->remainingExists;
+	return results->numFindAll > 0 || remainingExists > 0;
+}
+
+/*
+This method searches this process's portion for every pattern in the automaton in one pass. In the
+hybrid build the start positions are split into blocks across threadsPerRank threads with a static
+schedule, so each thread searches one contiguous run of blocks and each entry's positions come out
+sorted by concatenating the threads' arrays in thread order.
+*/
+void hostMatchGroup(ahoCorasick_ *automaton, groupSearch_ *results, long long lastI)
+{
+	int block, numBlocks;
+	numBlocks = (int) (lastI / SEARCH_BLOCK_SIZE + 1);
+
+#ifdef _OPENMP
+	#pragma omp parallel for shared(automaton, results) firstprivate(lastI, textData) private(block) num_threads(threadsPerRank) schedule(static)
+#endif
+	for (block = 0; block < numBlocks; block++)
+	{
+		int remainingExists;
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		if (lastPos > lastI)
+		{
+			lastPos = lastI;
+		}
+
+#ifdef _OPENMP
+		#pragma omp atomic read acquire
+#endif
+		remainingExists = results->remainingExists;
+		if (results->numFindAll > 0 || remainingExists > 0)
+		{ //blocks are skipped once every entry in the group has its answer
+			scanAhoCorasick(automaton, textData, firstPos, lastPos, textLength, recordGroupMatch, results);
+		}
+	}
+
+	//concatenate each entry's per-thread arrays in thread order, and add up its per-thread counts
+	for (int entry = 0; entry < results->numEntries; entry++)
+	{
+		for (int t = 0; t < threadsPerRank; t++)
+		{
+			results->counts[entry] += results->threadCounts[t * results->numEntries + entry];
+			positionList_ *part = &results->threadFoundAt[t * results->numEntries + entry];
+			for (long long i = 0; i < part->count; i++)
+				pushPosition(&results->foundAt[entry], part->positions[i]);
+			freePositions(part);
+		}
+	}
+}
 
 /*
-This method is a modified version of the original hostMatch, it allows the processes to store
-all positions at which they find a pattern match in a linked list, which is later reduced into 
-a single linked list in the master process. This method is only used when the search type is 
-a '1' ie. When all occurances of a pattern need to be found.
+This method makes control entry i the current search
 */
-linkedList_* hostMatchFindAll()
+void selectEntry(int i)
 {
-	int startPos,matchingCounter,currentPos, lastI;
+	typeOfRead = controlEntries[i].typeOfRead;
+	textNumber = controlEntries[i].textNumber;
+	patternNumber = controlEntries[i].patternNumber;
+}
 
-	startPos=0;
-	matchingCounter=0;
-	currentPos=0;
-	lastI = textLength-patternLength;
+/*
+This method is used by the master to find the next control entry that has not been searched and every
+later entry that uses the same text. They are stored in group and marked as done, so calling it again
+looks ahead to the following group. The number of entries is returned, 0 once every entry has been taken.
+When streamText or dynamicChunks is set every entry is searched on its own, as a group needs the whole text distributed.
+*/
+int collectGroup(int *group)
+{
+	int groupSize = 0;
+	int first = -1;
+	for (int j = 0; j < numControlEntries; j++)
+	{
+		if (controlEntries[j].done)
+			continue;
+		if (first == -1)
+			first = j;
+		if (strcmp(controlEntries[j].textNumber, controlEntries[first].textNumber) == 0)
+		{
+			group[groupSize++] = j;
+			controlEntries[j].done = true;
+			if (streamText || dynamicChunks)
+				break;
+		}
+	}
+	return groupSize;
+}
 
-    linkedList_* foundAtList;
-	foundAtList = (linkedList_*) realloc(foundAtList, sizeof(linkedList_)); //allocate memory for linked list object
-    foundAtList->next = NULL; //set linked list initial values
-    foundAtList->index = -1;
+/*
+This method searches a group of control entries that all use the same text. The master loads the text
+once and broadcasts every pattern in the group, then sends each process its portion of the text with a
+halo of the longest pattern length. Every process finds all of the patterns in its portion with a single
+Aho-Corasick pass (see aho_corasick.h), and the results are then reduced and written one entry at a
+time with reduceResults and printResultsToFile, exactly as for an individual search.
+*/
+void doGroupSearch(int *group, int groupSize)
+{
+	char *types = (char *) malloc(sizeof(char) * groupSize);
+	long long *lengths = (long long *) malloc(sizeof(long long) * groupSize);
+	char **patterns = (char **) malloc(sizeof(char *) * groupSize);
+	bool *mapped = (bool *) calloc(groupSize, sizeof(bool));
+	char **keywords = (char **) malloc(sizeof(char *) * groupSize);
+	int *keywordLengths = (int *) malloc(sizeof(int) * groupSize);
+	char *allPatterns = NULL;
+	long long totalPatternLength = 0;
+	long long maxPatternLength = 0;
+	int numKeywords = 0;
+	groupSearch_ results;
+	ahoCorasick_ automaton;
+
+	startMetrics(groupSize);
+	if (worldRank == 0)
+	{ //master loads the shared text once and every pattern in the group
+		double loadStart = MPI_Wtime();
+		double bytesLoaded;
+		textNumber = controlEntries[group[0]].textNumber;
+		if (parallelIO)
+		{ //each process reads its own portion later, the master only needs the size for now
+			textLength = textFileSize();
+			bytesLoaded = 0;
+		} else
+		{
+			readText(textNumber, &textData, &textLength, &textMapped);
+			bytesLoaded = textLength;
+		}
+		for (int k = 0; k < groupSize; k++)
+		{
+			types[k] = controlEntries[group[k]].typeOfRead;
+			readPattern(controlEntries[group[k]].patternNumber, &patterns[k], &lengths[k], &mapped[k]);
+			bytesLoaded += lengths[k];
+			if (textLength == 0 || textLength < lengths[k])
+			{ //patterns that can not be found are sent with a length of 0 and left out of the automaton
+				releaseFile(patterns[k], lengths[k], mapped[k]);
+				patterns[k] = NULL;
+				lengths[k] = 0;
+				mapped[k] = false;
+			}
+		}
+		reportLoadThroughput(loadStart, bytesLoaded);
+		printf ("\nSearching text file %s for %d patterns in a single pass\n", textNumber, groupSize);
+		printf ("Text length = %lld\n", textLength);
+	}
 
+	//every process needs every pattern to build the automaton
+	MPI_Bcast(types, groupSize, MPI_CHAR, 0, MPI_COMM_WORLD);
+	MPI_Bcast(lengths, groupSize, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+	for (int k = 0; k < groupSize; k++)
+	{
+		totalPatternLength += lengths[k];
+		if (lengths[k] > maxPatternLength)
+			maxPatternLength = lengths[k];
+	}
+	allPatterns = (char *) malloc(sizeof(char) * (totalPatternLength > 0 ? totalPatternLength : 1));
 	if (worldRank == 0)
-	{ //make sure master process only searches the first portion of the text
-		lastI = (textLength / worldSize) + patternLength;
-		if(lastI > textLength)
+	{
+		long long offset = 0;
+		for (int k = 0; k < groupSize; k++)
 		{
-			lastI = textLength;
+			memcpy(allPatterns + offset, patterns[k], lengths[k]);
+			offset += lengths[k];
 		}
 	}
-	while (startPos<=lastI)
+	broadcastLarge(allPatterns, totalPatternLength, MPI_CHAR, MPI_COMM_WORLD);
+
+	results.types = types;
+	results.keywordEntry = (int *) malloc(sizeof(int) * groupSize);
+	results.exists = (int *) malloc(sizeof(int) * groupSize);
+	results.numEntries = groupSize;
+	results.threadFoundAt = (positionList_ *) calloc((size_t) threadsPerRank * groupSize, sizeof(positionList_));
+	results.foundAt = (positionList_ *) calloc(groupSize, sizeof(positionList_));
+	results.threadCounts = (long long *) calloc((size_t) threadsPerRank * groupSize, sizeof(long long));
+	results.counts = (long long *) calloc(groupSize, sizeof(long long));
+	results.numFindAll = 0;
+	results.remainingExists = 0;
+	long long offset = 0;
+	for (int k = 0; k < groupSize; k++)
 	{
-		if (textData[currentPos] == patternData[matchingCounter])
+		results.exists[k] = -1;
+		if (lengths[k] > 0)
 		{
-			currentPos++;
-			matchingCounter++;
+			keywords[numKeywords] = allPatterns + offset;
+			keywordLengths[numKeywords] = (int) lengths[k]; //patterns are always far shorter than 2GB
+			results.keywordEntry[numKeywords] = k;
+			numKeywords++;
+			if (types[k] != '0')
+				results.numFindAll++;
+			else
+				results.remainingExists++;
 		}
-		else
+		offset += lengths[k];
+	}
+
+	if (numKeywords > 0)
+	{
+		long long lastI;
+		long long fullTextLength = textLength;
+		double phaseStart = MPI_Wtime();
+		//share out the portions of the text, each carrying on past its last start position by the longest pattern
+		MPI_Bcast(&fullTextLength, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+		if (parallelIO)
+		{ //every process reads its own portion
+			broadcastTextNumber();
+			readPortionOfText(fullTextLength, maxPatternLength - 1);
+		} else
+		{ //or the master scatters them
+			scatterPortions(fullTextLength, maxPatternLength - 1);
+		}
+		lastI = lastOwnedStart;
+		metrics.distributeSeconds = MPI_Wtime() - phaseStart;
+		metrics.textBytes = fullTextLength;
+
+		phaseStart = MPI_Wtime();
+		if (!buildAhoCorasick(&automaton, keywords, keywordLengths, numKeywords))
+			outOfMemory(totalPatternLength);
+		metrics.prepareSeconds = MPI_Wtime() - phaseStart;
+		if (lastI > textLength - automaton.minKeywordLength)
 		{
-			startPos++;
-			currentPos=startPos;
-			matchingCounter=0;
+			lastI = textLength - automaton.minKeywordLength;
 		}
+		phaseStart = MPI_Wtime();
+		if (lastI >= 0)
+		{
+			hostMatchGroup(&automaton, &results, lastI);
+		}
+		metrics.searchSeconds = MPI_Wtime() - phaseStart;
+		freeAhoCorasick(&automaton);
+		releaseNodePortions();
+	}
 
-        if (matchingCounter == patternLength)
-        {
-			//when a pattern is found, push the result to the list
-            pushToList(&foundAtList, startPos);
-			printf("process %d found a result at position %d\n", worldRank, startPos+startIndex);
-			numPatternsFound++;
-            startPos++;
-            matchingCounter=0;
-            currentPos=startPos;
-        }
+	//reduce and write the results one entry at a time
+	for (int k = 0; k < groupSize; k++)
+	{
+		typeOfRead = types[k];
+		exists = results.exists[k];
+		foundAt = results.foundAt[k];
+		numPatternsFound = types[k] == '2' ? results.counts[k] : foundAt.count;
+		if (worldRank == 0)
+		{
+			selectEntry(group[k]);
+			printf ("\nPattern file %s, pattern length = %lld\n", patternNumber, lengths[k]);
+			if (lengths[k] == 0)
+				printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
+		}
+		metrics.patternBytes = lengths[k];
+		reduceAndPrintResults();
 	}
-	return foundAtList;
+
+	if (worldRank == 0)
+	{
+		for (int k = 0; k < groupSize; k++)
+			releaseFile(patterns[k], lengths[k], mapped[k]);
+		releaseFile(textData, textLength, textMapped);
+		textData = NULL;
+		textMapped = false;
+	}
+	free(types);
+	free(lengths);
+	free(patterns);
+	free(mapped);
+	free(keywords);
+	free(keywordLengths);
+	free(allPatterns);
+	free(results.keywordEntry);
+	free(results.exists);
+	free(results.threadFoundAt);
+	free(results.foundAt);
+	free(results.threadCounts);
+	free(results.counts);
 }
 
 /*
-This method is very similar to the original hostMatch, except each process searches only their
-allocated portion of the fill text. This method is only used when the search type is 
-a '0' ie. When finding if a pattern exists in the text.
+This method is used by the master to answer a group of control entries that all use the same text from
+the text's suffix array index (see text_index.h), without the other processes. Each pattern is found with
+a binary search of the index and each entry's result is written exactly as for a distributed search.
+Returns false without searching if the text has no index newer than it, or the index does not match the
+text, so the group can be distributed and scanned instead.
 */
-int hostMatchFindExists()
+bool doIndexSearch(int *group, int groupSize)
 {
-    int startPos,matchingCounter,currentPos, lastI, isFound;
-	
-	startPos=0;
-	matchingCounter=0;
-	currentPos=0;
-	lastI = textLength-patternLength;
-	isFound = 0;
-    
-	if (worldRank == 0)
-	{ //make sure master process only searches the first portion of the text
-		//printf("process 0 has started searching\n");
-		lastI = (textLength / worldSize) + patternLength;
-		if(lastI > textLength)
-		{
-			lastI = textLength;
-		}
+	char fileName[1000];
+	char indexName[1000];
+	textIndex_ index;
+	textNumber = controlEntries[group[0]].textNumber;
+	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	sprintf (indexName, "large_inputs/text%s.sa", textNumber);
+	if (!textIndexIsFresh(fileName, indexName))
+		return false;
+
+	double loadStart = MPI_Wtime();
+	readText(textNumber, &textData, &textLength, &textMapped);
+	if (!loadTextIndex(indexName, textLength, &index))
+	{ //the index was built from a different text, scan this one instead
+		printf("\nIndex %s does not match text file %s, scanning the text\n", indexName, textNumber);
+		releaseFile(textData, textLength, textMapped);
+		textData = NULL;
+		textMapped = false;
+		return false;
 	}
+	double loadSeconds = MPI_Wtime() - loadStart;
+	printf ("\nSearching text file %s for %d pattern(s) using its suffix array index\n", textNumber, groupSize);
+	printf ("Text length = %lld\n", textLength);
 
-	while (startPos<=lastI && matchingCounter<patternLength)
+	for (int k = 0; k < groupSize; k++)
 	{
-		if (textData[currentPos] == patternData[matchingCounter])
+		startMetrics(groupSize);
+		metrics.loadSeconds = loadSeconds;
+		metrics.textBytes = textLength;
+		selectEntry(group[k]);
+		double phaseStart = MPI_Wtime();
+		readPattern(patternNumber, &patternData, &patternLength, &patternMapped);
+		metrics.loadSeconds += MPI_Wtime() - phaseStart;
+		metrics.patternBytes = patternLength;
+		printf ("\nPattern file %s, pattern length = %lld\n", patternNumber, patternLength);
+
+		phaseStart = MPI_Wtime();
+		combinedResult = -1;
+		combinedCount = 0;
+		if (textLength == 0 || patternLength == 0 || textLength < patternLength)
 		{
-			currentPos++;
-			matchingCounter++;
-		}
-		else
+			printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
+		} else if (typeOfRead == '0')
 		{
-			startPos++;
-			currentPos=startPos;
-			matchingCounter=0;
+			combinedResult = indexFindExists(&index, textData, patternData, patternLength);
+			printf(combinedResult == -2 ? "Pattern found\n" : "Pattern not found\n");
+		} else if (typeOfRead == '1')
+		{
+			allResults.count = indexFindAll(&index, textData, patternData, patternLength, &allResults.positions);
+			if (allResults.count < 0)
+				outOfMemory(textLength);
+			allResults.allocated = allResults.count;
+		} else if (typeOfRead == '2')
+		{ //the occurrences are next to each other in the index, so they are counted without being looked at
+			combinedCount = indexCount(&index, textData, patternData, patternLength);
+			printf("# of patterns found = %lld\n", combinedCount);
+		}
+		metrics.searchSeconds = MPI_Wtime() - phaseStart;
+		metrics.matches = typeOfRead == '0' ? combinedResult == -2 : typeOfRead == '2' ? combinedCount : allResults.count;
+		phaseStart = MPI_Wtime();
+		printResultsToFile();
+		metrics.writeSeconds = MPI_Wtime() - phaseStart;
+		if (metricsFile != NULL)
+		{ //only the master searched, so there is nothing to gather
+			metrics.numWorkers = 1;
+			metrics.workerSearchSeconds = &metrics.searchSeconds;
+			writeMetrics(metricsFile, textNumber, patternNumber, typeOfRead, &metrics);
 		}
+		releaseFile(patternData, patternLength, patternMapped);
+		patternData = NULL;
+		patternMapped = false;
 	}
-
-	if (matchingCounter == patternLength)
-		return -2;
-	else
-		return -1;
+	releaseTextIndex(&index);
+	releaseFile(textData, textLength, textMapped);
+	textData = NULL;
+	textMapped = false;
+	return true;
 }
 
 /*
-Checks to see if either of the files are empty, or if the text file is shorter than the pattern file
-In all of these cases the pattern will never be found, so the program will skip the search
+This method is used by the master to check if the text of control entry i has an index newer than it
 */
-bool checkForEmptyFiles() 
+bool entryHasIndex(int i)
 {
-    if (textLength == 0 || patternLength == 0 || textLength < patternLength)
-    { //pattern will not be found if text or pattern file is empty, or if the pattern is longer than the text
-		if(worldRank == 0) 
-		{ //master prints that search is being skipped
-			printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
-		}
-        return true;
-    }
-    return false;
+	char fileName[1000];
+	char indexName[1000];
+	sprintf (fileName, "large_inputs/text%s.txt", controlEntries[i].textNumber);
+	sprintf (indexName, "large_inputs/text%s.sa", controlEntries[i].textNumber);
+	return textIndexIsFresh(fileName, indexName);
 }
 
 /*
-This method will create a linked list to store all of the occurances that this process finds
-then it will call the hostMatchFindAll method which will populate the linked list with the results
+This method is used by the master to check a pattern against a text's q-gram filter (see qgram_filter.h).
+Returns true if the pattern has a 3-gram the text does not, so it can not occur in the text.
 */
-linkedList_* processDataFindAll()
+bool patternRuledOut(qgramFilter_ *filter, char *number)
 {
-	linkedList_* allOccurances = (linkedList_*) realloc(allOccurances, sizeof(linkedList_));
-	allOccurances->index = -1;
-	allOccurances->next = NULL;
-    if (checkForEmptyFiles())
-    { //skip the search if there is an empty file of if the text is shorter than the pattern
-        return allOccurances;
-    }
-
-    allOccurances = hostMatchFindAll();
-
-	return allOccurances;
+	char *data;
+	long long length;
+	bool mapped;
+	readPattern(number, &data, &length, &mapped);
+	bool ruledOut = length > 0 && !qgramFilterAllows(filter, data, length);
+	releaseFile(data, length, mapped);
+	return ruledOut;
 }
 
 /*
-This method will return -1 if a pattern does not exist in the text and -2 if it does.
+This method is used by the master to check if control entry i is a type '0' or '2' search that its text's
+q-gram filter shows can not find its pattern
 */
-int processDataFindExists()
+bool entryRuledOut(int i)
 {
-    if (checkForEmptyFiles())
-    { //skip the search if there is an empty file of if the text is shorter than the pattern
-        return -1;
-    }
-
-    //return -2 if pattern is found or -1 if pattern is not found
-    return hostMatchFindExists();
+	char fileName[1000];
+	char filterName[1000];
+	qgramFilter_ filter;
+	if (controlEntries[i].typeOfRead == '1')
+		return false;
+	sprintf (fileName, "large_inputs/text%s.txt", controlEntries[i].textNumber);
+	sprintf (filterName, "large_inputs/text%s.qg", controlEntries[i].textNumber);
+	if (!loadFreshQgramFilter(fileName, filterName, &filter))
+		return false;
+	bool ruledOut = patternRuledOut(&filter, controlEntries[i].patternNumber);
+	releaseQgramFilter(&filter);
+	return ruledOut;
 }
 
 /*
-This method will divide the text into portions using the master process and send 
-the allocated portion to each of the sub-processes. The sub-processes will recieve 
-its allocated portion of text and the full pattern to search. The master process also
-sends some meta data that is relevant to each search, such as the type of search to be
-performed, whether one or both of the files are empty, and the start index of where the 
-sub-process is starting its search in the main textData array.
+This method is used by the master to answer every type '0' and '2' entry of a group sharing a text whose
+pattern the text's q-gram filter shows can not occur. Each of them is written as not found, or a count of 0,
+without the text being read or sent, and is removed from the group. Returns the number of entries left to search.
 */
-void partitionTextData()
+int filterGroup(int *group, int groupSize)
 {
-	 if (worldRank == 0) //master process will create portions of text and send them to the other processes
+	char fileName[1000];
+	char filterName[1000];
+	qgramFilter_ filter;
+	int remaining = 0;
+	sprintf (fileName, "large_inputs/text%s.txt", controlEntries[group[0]].textNumber);
+	sprintf (filterName, "large_inputs/text%s.qg", controlEntries[group[0]].textNumber);
+	if (!loadFreshQgramFilter(fileName, filterName, &filter))
+		return groupSize;
+
+	for (int k = 0; k < groupSize; k++)
 	{
-		readData(); //read the pattern and text file and print their lengths
-        printf ("Text length = %d\n", textLength);
-        printf ("Pattern length = %d\n", patternLength);
-		int zero = 0;
-		int one = 1;
-		bool existsEmptyFile = checkForEmptyFiles(); //
-		for (int i = 1; i < worldSize; i++) 
-        { //work out start and end index for each process
-		
-			if(existsEmptyFile) 
-			{ //if one of the files are empty, or if the text file is shorter than the pattern file 
-				//then the master procress sends 
-				MPI_Send(&one, 1, MPI_INT, i, 900, MPI_COMM_WORLD); //900 tag corresponds to the empty file tracker, it will send 1 here as existsEmptyFile is true
-				MPI_Send(&typeOfRead, 1, MPI_CHAR, i, 600, MPI_COMM_WORLD); //600 tag corresponds to the type of search, 0 if checking if file exits, 1 if looking for all occurances
-				MPI_Send(&zero, 1, MPI_INT, i, 100, MPI_COMM_WORLD); //sends 0 as both text length and pattern length if existsEmptyFile is true
-				MPI_Send(&zero, 1, MPI_INT, i, 100, MPI_COMM_WORLD);
-			} else 
-			{
-				MPI_Send(&zero, 1, MPI_INT, i, 900, MPI_COMM_WORLD); //900 tag corresponds to the empty file tracker, it will send 0 here as existsEmptyFile is false
-				//calculate the portion size for each process
-				int jump = textLength / worldSize;
-				int startIndex = jump * i;
-				int endIndex = startIndex + jump + patternLength;
-
-				if (i == worldSize - 1 || endIndex > textLength)
-				{ //set end index to the text length for the last process, or if the endIndex exceeds the text length
-					endIndex = textLength;
-				}
-
-				sendPortionOfText(i, startIndex, endIndex); //send portion of text to process i
-				sendPattern(i); //send pattern to process i
-				MPI_Send(&startIndex, 1, MPI_INT, i, 500, MPI_COMM_WORLD); //send start index to process i
-				MPI_Send(&typeOfRead, 1, MPI_CHAR, i, 600, MPI_COMM_WORLD); //600 tag corresponds to the type of search, 0 if checking if file exits, 1 if looking for all occurances
-			}
-			
-		}	
-	} else
-	{//this else will be executed by all processes that are not the master
-		int existsEmptyFile;
-		MPI_Recv(&existsEmptyFile, 1, MPI_INT, 0, 900, MPI_COMM_WORLD, &status); //recieve either a 1 or 0, depending on if existsEmptyFile is true or false in the master process
-		if (existsEmptyFile == 0) //if there are no empty files
-		{
-			MPI_Recv(&textLength, 1, MPI_INT, 0, 100, MPI_COMM_WORLD, &status); //receive length of portion from master process
-			textData = (char *)realloc(textData, sizeof(char) * textLength); //allocate memory for portion of text data 
-			MPI_Recv(textData, textLength, MPI_CHAR, 0, 200, MPI_COMM_WORLD, &status); //receive portion of text from master process
-			MPI_Recv(&patternLength, 1, MPI_INT, 0, 100, MPI_COMM_WORLD, &status); //receive length of pattern from master process
-			patternData = (char *)realloc(patternData, sizeof(char) * patternLength); //allocate memory for the pattern
-			MPI_Recv(patternData, patternLength, MPI_CHAR, 0, 200, MPI_COMM_WORLD, &status); //receive pattern from master process
-			MPI_Recv(&startIndex, 1, MPI_INT, 0, 500, MPI_COMM_WORLD, &status); //receive start index from master process
-			MPI_Recv(&typeOfRead, 1, MPI_CHAR, 0, 600, MPI_COMM_WORLD, &status); //receive type of search to be executed
+		double phaseStart = MPI_Wtime();
+		if (controlEntries[group[k]].typeOfRead == '1' || !patternRuledOut(&filter, controlEntries[group[k]].patternNumber))
+		{ //the pattern might occur, so the text is searched as normal
+			group[remaining++] = group[k];
+			continue;
 		}
-		else //else there are empty files
-		{
-			MPI_Recv(&typeOfRead, 1, MPI_CHAR, 0, 600, MPI_COMM_WORLD, &status); //receive type of search to be executed
-			MPI_Recv(&textLength, 1, MPI_INT, 0, 100, MPI_COMM_WORLD, &status); //receive 0 so that search does not go ahead
-			MPI_Recv(&patternLength, 1, MPI_INT, 0, 100, MPI_COMM_WORLD, &status); //receive 0 so that search does not go ahead
+		startMetrics(1);
+		metrics.searchSeconds = MPI_Wtime() - phaseStart;
+		selectEntry(group[k]);
+		printf ("\nPattern file %s can not occur in text file %s, it has a 3-gram the text does not\nPattern not found\n", patternNumber, textNumber);
+		phaseStart = MPI_Wtime();
+		combinedResult = -1;
+		combinedCount = 0;
+		printResultsToFile();
+		metrics.writeSeconds = MPI_Wtime() - phaseStart;
+		if (metricsFile != NULL)
+		{ //only the master took part, so there is nothing to gather
+			metrics.numWorkers = 1;
+			metrics.workerSearchSeconds = &metrics.searchSeconds;
+			writeMetrics(metricsFile, textNumber, patternNumber, typeOfRead, &metrics);
 		}
-		
 	}
+	releaseQgramFilter(&filter);
+	return remaining;
 }
 
 /*
-This method will partition the data among the processes and then carry out the corresponding search
+This method searches the whole of text file text on this process alone for a --farm job of numEntries
+patterns. The text is loaded and searched like a portion that owns every start position, with threadsPerRank
+threads in the hybrid build. A single pattern is searched with the engine, and several at once with one
+Aho-Corasick pass as in doGroupSearch. The result of entry k is put in replies[k], and the positions of a
+type '1' search in positions[k]. A type '2' search only returns its count in replies[k].
 */
-void doSearch() 
+void runFarmJob(char *text, int numEntries, char *types, char **patternNumbers, farmReply_ *replies, positionList_ *positions)
 {
-    partitionTextData();
+	char **patterns = (char **) malloc(sizeof(char *) * numEntries);
+	long long *lengths = (long long *) malloc(sizeof(long long) * numEntries);
+	bool *mapped = (bool *) malloc(sizeof(bool) * numEntries);
+	char **keywords = (char **) malloc(sizeof(char *) * numEntries);
+	int *keywordLengths = (int *) malloc(sizeof(int) * numEntries);
+	int numKeywords = 0;
+	groupSearch_ results;
+	ahoCorasick_ automaton;
+	if (patterns == NULL || lengths == NULL || mapped == NULL || keywords == NULL || keywordLengths == NULL)
+		outOfMemory(numEntries);
+
+	readText(text, &textData, &textLength, &textMapped);
+	startIndex = 0;
+	lastOwnedStart = textLength; //every start position belongs to this process
+	results.types = types;
+	results.keywordEntry = (int *) malloc(sizeof(int) * numEntries);
+	results.exists = (int *) malloc(sizeof(int) * numEntries);
+	results.threadFoundAt = (positionList_ *) calloc((size_t) threadsPerRank * numEntries, sizeof(positionList_));
+	results.foundAt = positions;
+	results.threadCounts = (long long *) calloc((size_t) threadsPerRank * numEntries, sizeof(long long));
+	results.counts = (long long *) calloc(numEntries, sizeof(long long));
+	results.numEntries = numEntries;
+	results.numFindAll = 0;
+	results.remainingExists = 0;
+	for (int k = 0; k < numEntries; k++)
+	{
+		readPattern(patternNumbers[k], &patterns[k], &lengths[k], &mapped[k]);
+		results.exists[k] = -1;
+		if (textLength == 0 || lengths[k] == 0 || textLength < lengths[k])
+		{ //patterns that can not be found are not searched for
+			continue;
+		}
+		keywords[numKeywords] = patterns[k];
+		keywordLengths[numKeywords] = (int) lengths[k]; //patterns are always far shorter than 2GB
+		results.keywordEntry[numKeywords] = k;
+		numKeywords++;
+		if (types[k] != '0')
+			results.numFindAll++;
+		else
+			results.remainingExists++;
+	}
 
-    if (typeOfRead == '0') 
-    {
-        exists = processDataFindExists();
-    } else if (typeOfRead == '1')
-    {
-        foundAt = processDataFindAll();
-    } 
+	double searchStart = MPI_Wtime();
+	if (numKeywords == 1)
+	{ //a single pattern, use the engine
+		int k = results.keywordEntry[0];
+		patternData = patterns[k];
+		patternLength = lengths[k];
+		long long lastI = lastSearchPosition();
+		prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+		if (types[k] == '0')
+			results.exists[k] = searchBlocksForPattern(0, (int) (lastI / SEARCH_BLOCK_SIZE + 1), lastI);
+		else if (types[k] == '2')
+			results.counts[k] = hostMatchCount();
+		else
+			positions[k] = hostMatchFindAll();
+		patternData = NULL;
+		patternLength = 0;
+	} else if (numKeywords > 1)
+	{ //several patterns share the text, find them all in one pass
+		if (!buildAhoCorasick(&automaton, keywords, keywordLengths, numKeywords))
+			outOfMemory(numKeywords);
+		hostMatchGroup(&automaton, &results, textLength - automaton.minKeywordLength);
+		freeAhoCorasick(&automaton);
+	}
+	long long searchNanoseconds = (long long) ((MPI_Wtime() - searchStart) * 1e9);
+
+	for (int k = 0; k < numEntries; k++)
+	{
+		replies[k].exists = results.exists[k];
+		replies[k].count = types[k] == '2' ? results.counts[k] : positions[k].count;
+		replies[k].textLength = textLength;
+		replies[k].patternLength = lengths[k];
+		replies[k].searchNanoseconds = searchNanoseconds;
+		releaseFile(patterns[k], lengths[k], mapped[k]);
+	}
+	releaseFile(textData, textLength, textMapped);
+	textData = NULL;
+	textMapped = false;
+	free(patterns);
+	free(lengths);
+	free(mapped);
+	free(keywords);
+	free(keywordLengths);
+	free(results.keywordEntry);
+	free(results.exists);
+	free(results.threadFoundAt);
+	free(results.threadCounts);
+	free(results.counts);
 }
 
+/*
+This method is used by the master to write the result of control entry entry from a --farm job of groupSize
+entries. It takes over the positions found by a type '1' search, leaving positions empty.
+*/
+void writeFarmResult(int entry, int groupSize, farmReply_ *reply, positionList_ *positions, int worker)
+{
+	double writeStart = MPI_Wtime();
+	selectEntry(entry);
+	printf ("\nText file %s, pattern file %s searched whole by process %d, text length = %lld, pattern length = %lld\n",
+		textNumber, patternNumber, worker, reply->textLength, reply->patternLength);
+	combinedResult = (int) reply->exists;
+	combinedCount = reply->count;
+	allResults = *positions;
+	memset(positions, 0, sizeof(positionList_)); //printResultsToFile frees them
+	if (reply->textLength == 0 || reply->patternLength == 0 || reply->textLength < reply->patternLength)
+		printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
+	else if (typeOfRead == '0')
+		printf(combinedResult == -2 ? "Pattern found\n" : "Pattern not found\n");
+	else
+		printf("# of patterns found = %lld\n", reply->count);
+	startMetrics(groupSize);
+	metrics.matches = typeOfRead == '0' ? combinedResult == -2 : reply->count;
+	printResultsToFile();
+
+	if (metricsFile != NULL)
+	{ //the search was done by one process, so there is nothing to gather
+		metrics.textBytes = reply->textLength;
+		metrics.patternBytes = reply->patternLength;
+		metrics.searchSeconds = reply->searchNanoseconds / 1e9;
+		metrics.writeSeconds = MPI_Wtime() - writeStart;
+		metrics.numWorkers = 1;
+		metrics.workerSearchSeconds = &metrics.searchSeconds;
+		writeMetrics(metricsFile, textNumber, patternNumber, typeOfRead, &metrics);
+	}
+}
 
 /*
-This method will reduce the results back to the master process so it can print the results to the output file
+This method is used by the master to send a job to a process, or to tell it to stop if job is NULL. A job is
+sent as the text "textNumber type patternNumber type patternNumber ...", and an empty text means stop.
 */
-void reduceResults()
+void sendFarmJob(int worker, farmJob_ *job, int *farmEntries)
 {
-	if (typeOfRead == '0') 
-    { //if checking if a pattern exists in the text file, reduce the results to the minimum value found, which will be either -2 or -1
-		MPI_Reduce(&exists, &combinedResult, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD); 
-		if (worldRank == 0)
+	long long length = 1;
+	char *message;
+	if (job != NULL)
+	{
+		length += strlen(controlEntries[farmEntries[job->firstEntry]].textNumber);
+		for (int k = 0; k < job->numEntries; k++)
+			length += 3 + strlen(controlEntries[farmEntries[job->firstEntry + k]].patternNumber);
+	}
+	message = (char *) malloc(sizeof(char) * length);
+	if (message == NULL)
+		outOfMemory(length);
+	message[0] = '\0';
+	if (job != NULL)
+	{
+		long long used = sprintf(message, "%s", controlEntries[farmEntries[job->firstEntry]].textNumber);
+		for (int k = 0; k < job->numEntries; k++)
 		{
-			if(combinedResult == -1) 
+			controlEntry_ *entry = &controlEntries[farmEntries[job->firstEntry + k]];
+			used += sprintf(message + used, " %c %s", entry->typeOfRead, entry->patternNumber);
+		}
+	}
+	MPI_Send(message, (int) length, MPI_CHAR, worker, FARM_JOB_TAG, MPI_COMM_WORLD);
+	free(message);
+}
+
+int compareFarmJobs(const void *a, const void *b)
+{ //largest text first
+	long long sizeA = ((const farmJob_ *) a)->textSize;
+	long long sizeB = ((const farmJob_ *) b)->textSize;
+	return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+/*
+This method is the master's side of --farm. Every text of no more than farmThreshold bytes becomes a job made
+of all of its entries in the control file, less any the text's index or q-gram filter answers straight away.
+The jobs are handed out largest text first, one at a time: every other process gets one to start with and is
+sent the next as soon as it returns its results, so processes that draw small texts simply take more of them.
+Results are written as they come back. With a single process the master runs the jobs itself.
+*/
+void farmMaster()
+{
+	farmJob_ *jobs = (farmJob_ *) malloc(sizeof(farmJob_) * (numControlEntries > 0 ? numControlEntries : 1));
+	int *farmEntries = (int *) malloc(sizeof(int) * (numControlEntries > 0 ? numControlEntries : 1)); //entries of every job, job by job
+	int *workerJob = (int *) malloc(sizeof(int) * worldSize); //job each process is working on, -1 once it has been told to stop
+	int numJobs = 0, numFarmEntries = 0, nextJob = 0, busy = 0;
+	char fileName[1000];
+	struct stat fileInfo;
+	if (jobs == NULL || farmEntries == NULL || workerJob == NULL)
+		outOfMemory(numControlEntries);
+
+	for (int i = 0; i < numControlEntries; i++)
+	{
+		long long size;
+		sprintf (fileName, "large_inputs/text%s.txt", controlEntries[i].textNumber);
+		size = stat(fileName, &fileInfo) == 0 ? (long long) fileInfo.st_size : 0;
+		if (controlEntries[i].done || size > farmThreshold)
+		{ //large texts are split across every process once the jobs are done
+			continue;
+		}
+
+		int *group = farmEntries + numFarmEntries;
+		int groupSize = 0;
+		for (int j = i; j < numControlEntries; j++)
+		{
+			if (!controlEntries[j].done && strcmp(controlEntries[j].textNumber, controlEntries[i].textNumber) == 0)
 			{
-				printf("Pattern not found\n");
-			} else {
-				printf("Pattern found\n");
+				group[groupSize++] = j;
+				controlEntries[j].done = true;
 			}
 		}
-    } else if (typeOfRead == '1')
-    { //if searching for all occurances of a pattern, reduce the results to a single linked list datastructure in the master process
-        allResults = (linkedList_*) malloc(sizeof(linkedList_));
-		allResults->index = -1;
-		allResults->next = NULL;
-		printf("process %d found %d patterns\n", worldRank, numPatternsFound);
-		if (worldRank == 0)
+		if (doIndexSearch(group, groupSize))
+		{ //answered by the master without searching the text
+			continue;
+		}
+		groupSize = filterGroup(group, groupSize);
+		if (groupSize == 0)
+			continue;
+		jobs[numJobs].firstEntry = numFarmEntries;
+		jobs[numJobs].numEntries = groupSize;
+		jobs[numJobs].textSize = size;
+		numJobs++;
+		numFarmEntries += groupSize;
+	}
+	qsort(jobs, numJobs, sizeof(farmJob_), compareFarmJobs);
+	printf("\nHanding out %d searches on %d texts of up to %lld bytes to %d process(es)\n", numFarmEntries, numJobs,
+		farmThreshold, worldSize > 1 ? worldSize - 1 : 1);
+
+	double farmStart = MPI_Wtime();
+	farmReply_ *replies = (farmReply_ *) malloc(sizeof(farmReply_) * (numFarmEntries > 0 ? numFarmEntries : 1));
+	positionList_ *positions = (positionList_ *) calloc(numFarmEntries > 0 ? numFarmEntries : 1, sizeof(positionList_));
+	char *types = (char *) malloc(sizeof(char) * (numFarmEntries > 0 ? numFarmEntries : 1));
+	char **patternNumbers = (char **) malloc(sizeof(char *) * (numFarmEntries > 0 ? numFarmEntries : 1));
+	if (replies == NULL || positions == NULL || types == NULL || patternNumbers == NULL)
+		outOfMemory(numFarmEntries);
+	if (worldSize == 1)
+	{ //no other processes, the master searches everything itself
+		for (int j = 0; j < numJobs; j++)
 		{
-			while(foundAt->index != -1) 
-			{ //push the masters results to the linked list
-				pushToList(&allResults, foundAt->index);
-				foundAt = foundAt->next;
+			int *group = farmEntries + jobs[j].firstEntry;
+			for (int k = 0; k < jobs[j].numEntries; k++)
+			{
+				types[k] = controlEntries[group[k]].typeOfRead;
+				patternNumbers[k] = controlEntries[group[k]].patternNumber;
 			}
-			for (int i = 1; i < worldSize; i++) 
-			{ //iterate through all other processes and and add their results to the linked list
-				int numResults = 0;
-				MPI_Recv(&numResults, 1, MPI_INT, i, 50, MPI_COMM_WORLD, &status);
-				for (int k = 0; k < numResults; k++) {
-					int resultPos;
-					MPI_Recv(&resultPos, 1, MPI_INT, i, 60, MPI_COMM_WORLD, &status);
-					pushToList(&allResults, resultPos);
+			runFarmJob(controlEntries[group[0]].textNumber, jobs[j].numEntries, types, patternNumbers, replies, positions);
+			for (int k = 0; k < jobs[j].numEntries; k++)
+				writeFarmResult(group[k], jobs[j].numEntries, &replies[k], &positions[k], 0);
+		}
+	} else
+	{
+		for (int w = 1; w < worldSize; w++)
+		{ //give every process its first job
+			workerJob[w] = nextJob < numJobs ? nextJob++ : -1;
+			sendFarmJob(w, workerJob[w] >= 0 ? &jobs[workerJob[w]] : NULL, farmEntries);
+			if (workerJob[w] >= 0)
+				busy++;
+		}
+		while (busy > 0)
+		{ //collect the results of a job and send the process that returned them the next job
+			farmReply_ reply;
+			MPI_Recv(&reply, FARM_REPLY_LONGS, MPI_LONG_LONG, MPI_ANY_SOURCE, FARM_REPLY_TAG, MPI_COMM_WORLD, &status);
+			int worker = status.MPI_SOURCE;
+			farmJob_ *job = &jobs[workerJob[worker]];
+			for (int k = 0; k < job->numEntries; k++)
+			{
+				positionList_ found = {NULL, 0, 0};
+				if (k > 0)
+				{ //the rest of the job's results come from the same process, in order
+					MPI_Recv(&reply, FARM_REPLY_LONGS, MPI_LONG_LONG, worker, FARM_REPLY_TAG, MPI_COMM_WORLD, &status);
 				}
+				if (reply.count > 0 && controlEntries[farmEntries[job->firstEntry + k]].typeOfRead == '1')
+				{ //the positions can be more than INT_MAX, see largeCountType
+					MPI_Datatype positionsType = largeCountType(reply.count, MPI_LONG_LONG, 0);
+					reservePositions(&found, reply.count);
+					MPI_Recv(found.positions, 1, positionsType, worker, FARM_POSITIONS_TAG, MPI_COMM_WORLD, &status);
+					MPI_Type_free(&positionsType);
+					found.count = reply.count;
+				}
+				writeFarmResult(farmEntries[job->firstEntry + k], job->numEntries, &reply, &found, worker);
 			}
-		} else 
-		{ //sub-processes will send their results to the master process
-			MPI_Send(&numPatternsFound, 1, MPI_INT, 0, 50, MPI_COMM_WORLD);
-			for (int i = 0; i < numPatternsFound; i++) {
-				int actualRes = foundAt->index + startIndex;
-				MPI_Send(&actualRes, 1, MPI_INT, 0, 60, MPI_COMM_WORLD);
-				foundAt = foundAt->next;
-			}
+
+			workerJob[worker] = nextJob < numJobs ? nextJob++ : -1;
+			sendFarmJob(worker, workerJob[worker] >= 0 ? &jobs[workerJob[worker]] : NULL, farmEntries);
+			if (workerJob[worker] < 0)
+				busy--;
 		}
-    } 
+	}
+	printf("\nFinished %d handed out searches in %f seconds\n", numFarmEntries, MPI_Wtime() - farmStart);
+	free(jobs);
+	free(farmEntries);
+	free(workerJob);
+	free(replies);
+	free(positions);
+	free(types);
+	free(patternNumbers);
 }
 
 /*
-This process will print the results of a single search to the output file. 
+This method is the other processes' side of --farm. Each process runs the jobs the master sends it and
+returns the result of every entry, until it is sent an empty job.
 */
-void printResultsToFile() 
+void farmWorker()
 {
-	if (worldRank == 0) 
-	{ //only the master process prints the results
-		if (typeOfRead == '0') 
-    	{ //only one line is needed when checking if the file exists
-			insertLineInFile(combinedResult);
-		} else 
-		{ //if search is finding all appearances of the pattern, then iterate through the linked
-		  //list that is storing all the results and print each result to the output file.
-			removeDuplicates(allResults);
+	int jobsDone = 0;
+	while (true)
+	{
+		int length;
+		MPI_Probe(0, FARM_JOB_TAG, MPI_COMM_WORLD, &status);
+		MPI_Get_count(&status, MPI_CHAR, &length);
+		char *message = (char *) malloc(sizeof(char) * (length > 0 ? length : 1));
+		if (message == NULL)
+			outOfMemory(length);
+		MPI_Recv(message, length, MPI_CHAR, 0, FARM_JOB_TAG, MPI_COMM_WORLD, &status);
+		if (message[0] == '\0')
+		{ //no jobs left
+			free(message);
+			break;
+		}
 
-			if(allResults->index == -1) 
-			{
-				insertLineInFile(allResults->index);
-			}
-			while (allResults->index != -1) 
+		//the message is the text number followed by a type and pattern number for each entry
+		int maxEntries = length / 4 + 1;
+		char *types = (char *) malloc(sizeof(char) * maxEntries);
+		char **patternNumbers = (char **) malloc(sizeof(char *) * maxEntries);
+		int numEntries = 0;
+		char *text = strtok(message, " ");
+		char *token;
+		while ((token = strtok(NULL, " ")) != NULL)
+		{
+			types[numEntries] = token[0];
+			patternNumbers[numEntries] = strtok(NULL, " ");
+			if (patternNumbers[numEntries] == NULL)
+				break;
+			numEntries++;
+		}
+
+		farmReply_ *replies = (farmReply_ *) malloc(sizeof(farmReply_) * maxEntries);
+		positionList_ *positions = (positionList_ *) calloc(maxEntries, sizeof(positionList_));
+		if (types == NULL || patternNumbers == NULL || replies == NULL || positions == NULL)
+			outOfMemory(maxEntries);
+		runFarmJob(text, numEntries, types, patternNumbers, replies, positions);
+		for (int k = 0; k < numEntries; k++)
+		{
+			MPI_Send(&replies[k], FARM_REPLY_LONGS, MPI_LONG_LONG, 0, FARM_REPLY_TAG, MPI_COMM_WORLD);
+			if (replies[k].count > 0 && types[k] == '1')
 			{
-				insertLineInFile(allResults->index);
-				allResults = allResults->next;
+				MPI_Datatype positionsType = largeCountType(replies[k].count, MPI_LONG_LONG, 0);
+				MPI_Send(positions[k].positions, 1, positionsType, 0, FARM_POSITIONS_TAG, MPI_COMM_WORLD);
+				MPI_Type_free(&positionsType);
 			}
-			free(allResults);
+			freePositions(&positions[k]);
 		}
+		free(types);
+		free(patternNumbers);
+		free(replies);
+		free(positions);
+		free(message);
+		jobsDone++;
 	}
-	
+	printf("process %d searched %d whole texts\n", worldRank, jobsDone);
 }
 
 /*
 This method simply prints an entire file, it is used to print the control file to console
 */
-void printFile(char *fileData, int fileLength) 
+void printFile(char *fileData, long long fileLength) 
 {
-     for (int i = 0; i < fileLength; i++) {
+     for (long long i = 0; i < fileLength; i++) {
         printf("%c", fileData[i]);
     }
     printf("\n\n");
@@ -578,7 +3011,7 @@ void readControlFile()
 	readFromFile (f, &controlData, &controlLength);
     
     //Print the control file out to console
-    printf("Control Length = %d\n", controlLength);
+    printf("Control Length = %lld\n", controlLength);
     printf("=====Control File=====\n");
     printFile(controlData, controlLength);
     printf("======================\n");
@@ -607,12 +3040,14 @@ void determineSearchType()
     while (counter != 3 && controlToken != NULL)
     {
         if (counter % 3 == 0) 
-        {//The first token in a line is always the type of search to be done, it will always be either a '0' or '1'
+        {//The first token in a line is always the type of search to be done, it will always be either a '0', '1' or '2'
             typeOfRead = controlToken[0];
             if(typeOfRead == '0') {
                 printf ("\nFind if the pattern occurs ");
             } else if (typeOfRead == '1') {
                 printf ("\nFind every position of pattern ");
+            } else if (typeOfRead == '2') {
+                printf ("\nCount the occurrences of pattern ");
             }
         } else if (counter % 3 == 1) 
         { //The second token specifies the text number to use 
@@ -635,47 +3070,327 @@ void determineSearchType()
 	}
 }
 
+/*
+This method reads every entry in the control file into controlEntries so that entries
+which share a text can be searched together
+*/
+void readControlEntries()
+{
+	int allocatedEntries = 16;
+	controlEntries = (controlEntry_ *) malloc(sizeof(controlEntry_) * allocatedEntries);
+	numControlEntries = 0;
+
+	determineSearchType();
+	while (allSearchesDone != 1)
+	{
+		if (numControlEntries == allocatedEntries)
+		{
+			allocatedEntries *= 2;
+			controlEntries = (controlEntry_ *) realloc(controlEntries, sizeof(controlEntry_) * allocatedEntries);
+			if (controlEntries == NULL)
+				outOfMemory(sizeof(controlEntry_) * allocatedEntries);
+		}
+		controlEntries[numControlEntries].typeOfRead = typeOfRead;
+		controlEntries[numControlEntries].textNumber = textNumber;
+		controlEntries[numControlEntries].patternNumber = patternNumber;
+		controlEntries[numControlEntries].done = false;
+		numControlEntries++;
+		determineSearchType();
+	}
+}
+
+/*
+This method reads the command line options. Every process is given the same arguments by mpirun,
+so each one parses them itself. The input directory given by the jobscript is ignored as the paths
+are fixed, so only options starting with -- are looked at.
+*/
+void parseArguments(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--threads=", 10) == 0)
+		{ //number of OpenMP threads each process searches with, only used by the hybrid build
+			threadsPerRank = atoi(argv[i] + 10);
+			if (threadsPerRank < 1)
+				threadsPerRank = 1;
+#ifndef _OPENMP
+			if (worldRank == 0)
+				printf("--threads= has no effect unless built with -fopenmp (see jobscript_hybrid.sh)\n");
+			threadsPerRank = 1;
+#endif
+		} else if (strcmp(argv[i], "--metrics") == 0)
+		{ //write the phase timings of every search to metrics_MPI.csv
+			metricsEnabled = true;
+		} else if (strcmp(argv[i], "--pipeline") == 0)
+		{ //the master reads and sends the next search while the current one runs
+			pipeline = true;
+		} else if (strcmp(argv[i], "--parallel-io") == 0)
+		{ //every process reads its own portion of each text with MPI-IO
+			parallelIO = true;
+		} else if (strcmp(argv[i], "--farm") == 0)
+		{ //hand out searches on small texts whole to single processes
+			farm = true;
+		} else if (strncmp(argv[i], "--farm-threshold=", 17) == 0)
+		{ //largest text in bytes that --farm hands out whole
+			farmThreshold = atoll(argv[i] + 17);
+		} else if (strcmp(argv[i], "--stream") == 0)
+		{ //every process reads and searches its share of each text a chunk at a time
+			streamText = true;
+		} else if (strncmp(argv[i], "--chunk-size=", 13) == 0)
+		{ //number of start positions in each chunk when streaming
+			streamChunkSize = atoi(argv[i] + 13);
+			if (streamChunkSize < 1)
+				streamChunkSize = 1;
+		} else if (strcmp(argv[i], "--shared-memory") == 0)
+		{ //processes on the same node search one shared copy of each text
+			sharedMemory = true;
+		} else if (strcmp(argv[i], "--dynamic") == 0)
+		{ //the master hands out chunks of each text to the other processes as they finish the last one
+			dynamicChunks = true;
+		} else if (strncmp(argv[i], "--dynamic-chunk-size=", 21) == 0)
+		{ //number of start positions in each chunk handed out with --dynamic
+			dynamicChunkSize = atoi(argv[i] + 21);
+			if (dynamicChunkSize < 1)
+				dynamicChunkSize = 1;
+		} else if (strncmp(argv[i], "--engine=", 9) == 0)
+		{ //choose the search engine used by hostMatchFindExists and hostMatchFindAll
+			if (!parseSearchEngine(argv[i] + 9, &engineType))
+			{
+				if (worldRank == 0)
+					fprintf(stderr, "Unknown search engine %s, expected naive, horspool or twoway\n", argv[i] + 9);
+				MPI_Abort(MPI_COMM_WORLD, 1);
+			}
+		}
+	}
+	if (pipeline && parallelIO)
+	{ //every process reads its own text with --parallel-io, so there is nothing for the master to send ahead
+		if (worldRank == 0)
+			printf("--pipeline has no effect with --parallel-io\n");
+		pipeline = false;
+	}
+	if (pipeline && streamText)
+	{ //with --stream every process reads its own text as it searches, there is nothing to send ahead
+		if (worldRank == 0)
+			printf("--pipeline has no effect with --stream\n");
+		pipeline = false;
+	}
+	if (dynamicChunks && (worldSize == 1 || parallelIO || streamText))
+	{ //chunks are handed out from the master's copy of the text to the other processes
+		if (worldRank == 0)
+			printf("--dynamic has no effect with a single process, --parallel-io or --stream\n");
+		dynamicChunks = false;
+	}
+	if (sharedMemory && (parallelIO || streamText || dynamicChunks))
+	{ //only the portions the master sends are shared
+		if (worldRank == 0)
+			printf("--shared-memory has no effect with --parallel-io, --stream or --dynamic\n");
+		sharedMemory = false;
+	}
+	if (pipeline && dynamicChunks)
+	{ //the chunks are handed out during the search, there is nothing to send ahead
+		if (worldRank == 0)
+			printf("--pipeline has no effect with --dynamic\n");
+		pipeline = false;
+	}
+	if (worldRank == 0)
+		printf("Using the %s search engine (%s candidate filter) with %d thread(s) per process\n", searchEngineName(engineType), simdLevelName(detectSimdLevel()), threadsPerRank);
+}
+
 /*
 Main method will initilise MPI environment and perform searches until all searches are completed.
 */
 int main(int argc, char **argv)
 {
-    //initialize the MPI environment
+    //initialize the MPI environment, the hybrid build needs threads but only the main thread ever calls MPI
+#ifdef _OPENMP
+	int threadSupport;
+	MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &threadSupport);
+	threadsPerRank = omp_get_max_threads();
+#else
 	MPI_Init(NULL, NULL);
+#endif
 
 	//find out rank for each process and world size 
 	MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
 	MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+	parseArguments(argc, argv);
+	initPortionTransfer(&textTransfer);
+	if (sharedMemory)
+	{
+		initNodeComms();
+	}
+#ifdef _OPENMP
+	if (threadSupport < MPI_THREAD_FUNNELED)
+	{ //without funneled support the threads can not safely run alongside MPI
+		if (worldRank == 0)
+			printf("MPI library does not support MPI_THREAD_FUNNELED, searching with one thread per process\n");
+		threadsPerRank = 1;
+	}
+#endif
 
 
-	//master process will generate the output file, read in the control file, and determine what the first search is
+	//master process will generate the output file, read in the control file, and determine what the first two groups of searches are
+	int *group = NULL;
+	int *nextGroup = NULL;
+	int groupSize = 0;
+	int nextGroupSize = 0;
+	int loopInfo[3]; //size of the current group, 1 if the next search is being staged while this one runs, and 1 if the master answered the whole group on its own
+	int current = 0; //stagedSearches slot holding the current search
+	bool currentStaged = false; //true if the current search was sent ahead with stageSearch
+	if (pipeline)
+	{
+		initStagedSearches();
+	}
+	if (metricsEnabled && worldRank == 0)
+	{
+		metricsFile = openMetricsFile("metrics_MPI.csv");
+		rankSearchTime = (double *) malloc(sizeof(double) * worldSize);
+		if (rankSearchTime == NULL)
+			outOfMemory(worldSize);
+	}
+	if (dynamicChunks && worldRank == 0)
+	{
+		chunksSearched = (long long *) calloc(worldSize, sizeof(long long));
+		if (chunksSearched == NULL)
+			outOfMemory(worldSize);
+	}
 	if (worldRank == 0)
 	{ 
  		generateOutputFile();
 		readControlFile();
-		determineSearchType();
+		readControlEntries();
 	}
-   
+	if (farm)
+	{ //searches on small texts are handed out whole first, the rest are split across every process below
+		if (worldRank == 0)
+			farmMaster();
+		else
+			farmWorker();
+	}
+	if (worldRank == 0)
+	{
+		group = (int *) malloc(sizeof(int) * (numControlEntries > 0 ? numControlEntries : 1));
+		nextGroup = (int *) malloc(sizeof(int) * (numControlEntries > 0 ? numControlEntries : 1));
+		groupSize = collectGroup(group);
+		nextGroupSize = collectGroup(nextGroup);
+		allSearchesDone = groupSize == 0;
+	}
+	MPI_Bcast(&allSearchesDone, 1, MPI_INT, 0, MPI_COMM_WORLD);
     
 	while (allSearchesDone != 1) 
 	{ //this loop will perform searches until allSearchesDone is set to 1
-		numPatternsFound = 0;
-		doSearch();
-		reduceResults();
-		printResultsToFile();
-		if (worldRank == 0 && controlRead) {
-			free(textData);
-			free(patternData);
-			determineSearchType();
+		//every process needs to know if this is a single search or a group of searches sharing a text,
+		//and if the next search will be sent ahead while this one runs
+		if (worldRank == 0)
+		{ //groups on indexed texts, and exists searches the text's q-gram filter rules out, are answered by the master alone,
+			//so they are never sent ahead, and a search that was sent ahead is searched as planned
+			bool answered = !currentStaged && doIndexSearch(group, groupSize);
+			if (!currentStaged && !answered)
+			{
+				groupSize = filterGroup(group, groupSize);
+				answered = groupSize == 0;
+			}
+			loopInfo[0] = groupSize;
+			loopInfo[2] = answered;
+			loopInfo[1] = pipeline && !answered && groupSize == 1 && nextGroupSize == 1 &&
+				!entryHasIndex(nextGroup[0]) && !entryRuledOut(nextGroup[0]);
+		}
+		MPI_Bcast(loopInfo, 3, MPI_INT, 0, MPI_COMM_WORLD);
+		groupSize = loopInfo[0];
+		bool stageNext = loopInfo[1];
+		bool answeredByMaster = loopInfo[2];
+		stagedSearch_ *next = &stagedSearches[1 - current];
+
+		if (answeredByMaster)
+		{ //the master has already written the group's results, there is nothing for the other processes to do
+		} else if (groupSize == 1)
+		{ //the only search on this text, use the single pattern engine
+			if (worldRank == 0)
+				selectEntry(group[0]);
+			numPatternsFound = 0;
+			startMetrics(1);
+			double phaseStart = MPI_Wtime();
+			if (currentStaged)
+			{ //the data was sent ahead during the last search
+				activateStagedSearch(&stagedSearches[current]);
+			} else
+			{
+				distributeSearch();
+			}
+			metrics.distributeSeconds = MPI_Wtime() - phaseStart - metrics.loadSeconds;
+			if (currentStaged && worldRank == 0)
+			{ //the text was read during the last search
+				metrics.loadSeconds = stagedSearches[current].loadSeconds;
+				metrics.overlapSeconds = stagedSearches[current].overlapSeconds;
+			}
+			if (stageNext)
+			{ //start reading the next search and sending its metadata before searching this one
+				if (worldRank == 0)
+					stageSearch(next, nextGroup[0]);
+				else
+					receiveStagedMetadata(next);
+			}
+			doSearch();
+			releaseNodePortions();
+			if (stageNext)
+			{ //send and receive the next text while the results are reduced
+				if (worldRank == 0)
+					sendStagedText(next);
+				else
+					receiveStagedData(next);
+			}
+			reduceAndPrintResults();
+			if (worldRank == 0)
+			{
+				if (currentStaged)
+					finishStagedSearch(&stagedSearches[current]);
+				releaseData();
+			}
+		} else
+		{ //several searches share this text, answer them all with one pass
+			doGroupSearch(group, groupSize);
+		}
+		currentStaged = stageNext;
+		if (stageNext)
+		{
+			current = 1 - current;
+		}
+		if (worldRank == 0)
+		{ //move on to the next group and look ahead to the one after it
+			int *swap = group;
+			group = nextGroup;
+			nextGroup = swap;
+			groupSize = nextGroupSize;
+			nextGroupSize = collectGroup(nextGroup);
+			allSearchesDone = groupSize == 0;
 		}
 		//Broadcast barrier will allow all processes to wait on the master to determine if another search needs to be performed
 		MPI_Bcast(&allSearchesDone, 1, MPI_INT, 0, MPI_COMM_WORLD);
 	}
+	free(group);
+	free(nextGroup);
+	if (pipeline)
+	{
+		MPI_Comm_free(&stagingComm);
+	}
+	if (sharedMemory)
+	{
+		MPI_Comm_free(&nodeComm);
+		if (leaderComm != MPI_COMM_NULL)
+			MPI_Comm_free(&leaderComm);
+	}
 
 	//master process closes the output file once all results have been written to it
 	if (worldRank == 0)
 	{
+		for (int w = 1; dynamicChunks && w < worldSize; w++)
+		{ //a process that searched far fewer chunks than the others is on a slow or busy node
+			printf("process %d searched %lld chunks in total\n", w, chunksSearched[w]);
+		}
+		free(chunksSearched);
     	fclose(outputFile);
+		if (metricsFile != NULL)
+			fclose(metricsFile);
 	}
 
 	//finialise MPI and finish program
@@ -8,6 +8,12 @@
 #include <omp.h>
 #include <execinfo.h>
 #include <stdbool.h>
+#include "text_io.h"
+#include "search_engines.h"
+#include "aho_corasick.h"
+#include "metrics.h"
+#include "text_index.h"
+#include "qgram_filter.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // OMP PROJECT - SHEA KITSON - 40202515
@@ -19,53 +25,111 @@ I used a static parallel for loop schedule with no defined chunk size. This way
 Not defining a chunk size allows the scheduler to more freely adapt to the large changes in the sizes of the text file to be searched.
 For example, a chunk size of 10,000 would be no good for a text file with a size of 10. 
 
-When checking if a pattern exists in the text, if any threads find the pattern they will update the shared 'isFound' variable.
-Subsequent searches on different threads will see this and know that the pattern is already found, so they can skip the search.
+When checking if a pattern exists in the text, if any threads find the pattern they will update the shared 'isFound' variable
+with an atomic store and cancel the loop with 'omp cancel for' (jobscript_OMP.sh sets OMP_CANCELLATION=true so this takes effect).
+Every thread atomically reads 'isFound' before each block, so they stop within one block of the first hit, not at the end of their portion.
 This acts as an early stopping mechanism and is very effective if the pattern appears at the start of a segment that is being searched,
 as it means all the other threads do not have to pointlessly search through their entire allocated portion of teh text.
 
 If either the text or pattern file is empty, or if the text file is shorter than the pattern file, then the search is skipped as it 
 is impossible for the pattern to be found when any of these things are true. When this happens I report it as pattern not found.
 
-The linked list structure that is used to hold all occurances of a pattern will dynamically allocate its memory each time a new element 
-is added to the list. Although this does not directly affect how fast the program executes, it means I am not statically allocating more
-memory than necessary to hold the results.
+The text and pattern files are memory mapped read-only (see text_io.h) rather than copied in one byte at a time, so loading
+a large text no longer costs more than searching it. readData prints the load throughput for each search.
+
+The searches themselves are done by a pluggable engine (see search_engines.h) chosen with --engine=naive|horspool|twoway.
+The start positions are split into blocks of SEARCH_BLOCK_SIZE and each thread runs the engine over whole blocks, so engines
+that skip ahead (Horspool) or remember earlier comparisons (Two-Way) can do so within a block.
+
+The whole control file is read up front and entries that use the same text are searched together: the text is loaded once
+and all of their patterns are found in a single Aho-Corasick pass (see aho_corasick.h) instead of one scan per entry.
+
+When finding all occurances, each thread stores the positions it finds in its own growable array (doubling in size when full) rather
+than pushing them onto a shared linked list in a critical section, so threads never wait on each other or on malloc for every match.
+The arrays are concatenated in order at the end, in parallel, so the positions are written to the output file in ascending order.
+
+With --stream texts are never loaded whole. They are read in fixed size chunks, each carrying patternLength - 1 characters
+over into the next, and searched a round of chunks at a time through a pool of one buffer per thread, so texts larger than
+memory can be searched in a fixed amount of memory (see streamSearch).
+
+With --metrics the time taken by each phase of every search, and by each thread, is written to metrics_OMP.csv (see metrics.h).
+
+With --build-index a suffix array of every text in the control file is built in parallel and saved next to the text (see text_index.h)
+before the searches start. Whenever a text has an index that is newer than it, every entry on that text is answered from the index
+with a binary search instead of scanning the text, and texts without one are scanned as before.
+
+With --batch the control entries are searched as OpenMP tasks in one parallel region instead of one after another, so a control
+file of many small texts no longer pays for a fork and join, and mostly idle threads, per entry. Each entry loads its own text and
+pattern, small searches run whole on the thread that picks them up, and large ones are split into block tasks (see runBatch).
+Entries sharing a text are searched separately in this mode rather than with one Aho-Corasick pass.
+
+With --build-filter a bitmap of the 3-grams in every text of the control file is saved next to the text (see qgram_filter.h).
+A type '0' search whose pattern has a 3-gram missing from its text's bitmap is answered -1 straight away, without the text
+being loaded or scanned, so the common case of a pattern that is not there no longer costs a full scan.
+
+A type '2' search only counts the occurrences of the pattern and writes one line with the count. Each thread counts the matches
+in its blocks and the counts are summed with an OpenMP reduction(+), so no positions are stored and the memory used does not grow
+with the number of matches. The count is also taken from the index, the q-gram filter (0), a stream or a batch task.
 */
 
-int num_threads = 4; //set number of threads
+int num_threads = 4; //set number of threads, can be changed with --threads=
+
+bool metricsEnabled = false; //set by --metrics, one line of phase timings is written per control entry
+FILE *metricsFile = NULL; //metrics_OMP.csv, see metrics.h
+searchMetrics_ metrics; //phase timings of the current search
+double *threadSearchTime = NULL; //time each thread spent searching during the last search
+
+bool streamText = false; //set by --stream, texts are read and searched a chunk at a time instead of being loaded whole
+int streamChunkSize = 64 * 1024 * 1024; //number of start positions in each chunk, set with --chunk-size=
+
+bool batchMode = false; //set by --batch, the control entries are searched as OpenMP tasks instead of one after another
+#define BATCH_SPLIT_LENGTH (16 * SEARCH_BLOCK_SIZE) //in batch mode, searches with more start positions than this are split into block tasks
+
+bool buildIndexes = false; //set by --build-index, a suffix array is built for every text in the control file before searching
+bool buildFilters = false; //set by --build-filter, a q-gram filter is built for every text in the control file before searching
+
+#define SEARCH_BLOCK_SIZE 65536 //number of start positions each thread searches as one unit of work
+
+searchEngineType_ engineType = ENGINE_NAIVE; //search engine to use, chosen with the --engine= command line option
+searchEngine_ engine; //engine prepared from the current pattern, shared read-only by all threads
 
 char *textData;
-int textLength;
+long long textLength; //64-bit so texts larger than 2GB can be searched
+bool textMapped = false; //true if textData is a read-only mapping of the text file rather than a heap buffer
 
 char *patternData;
-int patternLength;
+long long patternLength;
+bool patternMapped = false; //true if patternData is a read-only mapping of the pattern file
 
 char *controlData; //stores the data from the control file
-int controlLength; //stores length of control file
+long long controlLength; //stores length of control file
 
-char typeOfRead; //stores the type of search to be done, i.e. '0' to find if pattern exists or '1' to find all occurances of pattern
+char typeOfRead; //stores the type of search to be done, i.e. '0' to find if pattern exists, '1' to find all occurances of pattern or '2' to count them
 char* textNumber; //stores text number to be searched
 char* patternNumber; //stores pattern number that the program is searching for
 
 FILE *outputFile; //File to output results
 
+typedef struct controlEntry
+{ //one line of the control file
+	char typeOfRead;
+	char *textNumber;
+	char *patternNumber;
+	bool done; //set once the entry has been searched, possibly as part of a group sharing its text
+} controlEntry_;
+
+controlEntry_ *controlEntries; //every entry in the control file, read up front so entries sharing a text can be grouped
+int numControlEntries;
+
 bool controlRead = false; //indicates if the control file read has been started or not
 int allSearchesDone = 0; //indicates if all of the searches are complete, changes to 1 once they are all complete
 
-typedef struct linkedList 
-{  //define linked list structure which is used to store all positions that pattern is found
-    int index;
-    struct linkedList* next;
-}linkedList_;
-
-void pushToList(linkedList_ ** head, int value)
-{ //This method will push a value to the front of the linked list
-	linkedList_* foundAt;
-	foundAt = (linkedList_*) malloc(sizeof(linkedList_));
-	foundAt->index = value;
-	foundAt->next= *head;
-	*head = foundAt;
-}
+typedef struct positionList 
+{  //growable array used to store all positions that pattern is found, each thread fills its own so no locking is needed
+    long long *positions; //positions in the text, 64-bit so texts larger than 2GB can be searched
+    long long count;
+    long long allocated;
+}positionList_;
 
 void generateOutputFile() 
 { //This method will generate the output file to store results
@@ -74,13 +138,13 @@ void generateOutputFile()
 	outputFile = fopen(fileName, "w");
 }
 
-void insertLineInFile(int result) 
+void insertLineInFile(long long result) 
 { //This method will insert a line in the output file in the format textFile patternFile result
     fputs(textNumber, outputFile);
     fputc(' ', outputFile);
     fputs(patternNumber, outputFile);
     fputc(' ', outputFile);
-    fprintf(outputFile, "%d", result);
+    fprintf(outputFile, "%lld", result);
     fputc('\n', outputFile);
 }
 
@@ -91,119 +155,270 @@ void outOfMemory()
 	exit (0);
 }
 
-//standard method taken from searching_sequential.c from Blesson
-void readFromFile (FILE *f, char **data, int *length)
-{
-	int ch;
-	int allocatedLength;
-	char *result;
-	int resultLength = 0;
-
-	allocatedLength = 0;
-	result = NULL;
-
-	ch = fgetc (f);
-	while (ch >= 0)
+void pushPosition(positionList_ *list, long long value)
+{ //This method will add a value to the end of the list, doubling its size when it is full
+	if (list->count == list->allocated)
 	{
-		resultLength++;
-		if (resultLength > allocatedLength)
-		{
-			allocatedLength += 10000;
-			result = (char *) realloc (result, sizeof(char)*allocatedLength);
-			if (result == NULL)
-				outOfMemory();
-		}
-		result[resultLength-1] = ch;
-		ch = fgetc(f);
+		list->allocated = list->allocated > 0 ? list->allocated * 2 : 1024;
+		list->positions = (long long *) realloc(list->positions, sizeof(long long) * list->allocated);
+		if (list->positions == NULL)
+			outOfMemory();
 	}
-	*data = result;
-	*length = resultLength;
+	list->positions[list->count++] = value;
 }
 
-//standard method taken from searching_sequential.c from Blesson
-int readData ()
+void freePositions(positionList_ *list)
+{ //This method releases the memory held by a list and leaves it empty
+	free(list->positions);
+	list->positions = NULL;
+	list->count = 0;
+	list->allocated = 0;
+}
+
+/*
+This method reads the whole of an open file into a heap buffer. It used to be the fgetc loop from
+searching_sequential.c, it now reads the file in large blocks (see readFileBuffered in text_io.h).
+It is used for the control file, which is tokenised in place so needs a writable copy, and as the
+fallback for text and pattern files that can not be mapped.
+*/
+void readFromFile (FILE *f, char **data, long long *length)
+{
+	if (!readFileBuffered(f, data, length))
+		outOfMemory();
+}
+
+/*
+This method loads a text or pattern file, mapping it into memory if possible and otherwise reading
+it into a buffer. isMapped records which was done so that releaseData frees it the right way.
+Returns 0 if the file could not be opened.
+*/
+int loadFile (char *fileName, char **data, long long *length, bool *isMapped)
 {
 	FILE *f;
+	*isMapped = mapFile(fileName, data, length);
+	if (*isMapped)
+		return 1;
+
+	f = fopen (fileName, "r");
+	if (f == NULL)
+		return 0;
+	readFromFile (f, data, length);
+	fclose (f);
+	return 1;
+}
+
+/*
+This method writes the paths of text file number and of its suffix array index into fileName
+*/
+void textFileName (char *fileName, char *number)
+{
+	sprintf (fileName, "large_inputs/text%s.txt", number);
+}
+
+void indexFileName (char *fileName, char *number)
+{
+	sprintf (fileName, "large_inputs/text%s.sa", number);
+}
+
+void filterFileName (char *fileName, char *number)
+{
+	sprintf (fileName, "large_inputs/text%s.qg", number);
+}
+
+/*
+This method loads text file textNumber into textData
+*/
+int readText ()
+{
 	char fileName[1000];
 #ifdef DOS
         sprintf (fileName, "inputs\\test%d\\text.txt", testNumber);
 #else
-	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	textFileName (fileName, textNumber);
 #endif
-	f = fopen (fileName, "r");
-	if (f == NULL)
+	if (!loadFile (fileName, &textData, &textLength, &textMapped))
+	{ //a missing text is treated as empty so the search is skipped
+		textData = NULL;
+		textLength = 0;
+		textMapped = false;
 		return 0;
-	readFromFile (f, &textData, &textLength);
-	fclose (f);
+	}
+	return 1;
+}
+
+/*
+This method loads pattern file number into data
+*/
+int readPattern (char *number, char **data, long long *length, bool *isMapped)
+{
+	char fileName[1000];
 #ifdef DOS
         sprintf (fileName, "inputs\\test%d\\pattern.txt", testNumber);
 #else
-	sprintf (fileName, "large_inputs/pattern%s.txt", patternNumber);
+	sprintf (fileName, "large_inputs/pattern%s.txt", number);
 #endif
-	f = fopen (fileName, "r");
-	if (f == NULL)
+	if (!loadFile (fileName, data, length, isMapped))
+	{ //a missing pattern is treated as empty so it is reported as not found
+		*data = NULL;
+		*length = 0;
+		*isMapped = false;
 		return 0;
-	readFromFile (f, &patternData, &patternLength);
-	fclose (f);
+	}
+	return 1;
+}
 
+/*
+This method prints how quickly the data for a search was loaded
+*/
+void reportLoadThroughput (double loadStart, double bytesLoaded)
+{
+	double loadTime = omp_get_wtime() - loadStart;
+	double megabytes = bytesLoaded / (1024.0 * 1024.0);
+	printf ("Loaded %.2f MB in %f seconds (%.1f MB/s)%s\n", megabytes, loadTime,
+		loadTime > 0 ? megabytes / loadTime : 0.0, textMapped ? " using mmap" : "");
+}
+
+//standard method taken from searching_sequential.c from Blesson
+int readData ()
+{
+	double loadStart = omp_get_wtime();
+	if (!readText ())
+		return 0;
+	if (!readPattern (patternNumber, &patternData, &patternLength, &patternMapped))
+		return 0;
+
+	//report how quickly the text and pattern were loaded
+	reportLoadThroughput (loadStart, textLength + (double) patternLength);
 	return 1;
+}
+
+/*
+This method releases the text and pattern loaded by readData
+*/
+void releaseData ()
+{
+	releaseFile(textData, textLength, textMapped);
+	releaseFile(patternData, patternLength, patternMapped);
+	textData = NULL;
+	patternData = NULL;
+	textMapped = false;
+	patternMapped = false;
+}
 
+/*
+This method sets every thread's search time back to zero, making room for num_threads threads
+*/
+void resetThreadSearchTimes()
+{
+	threadSearchTime = (double *) realloc(threadSearchTime, sizeof(double) * num_threads);
+	if (threadSearchTime == NULL)
+		outOfMemory();
+	memset(threadSearchTime, 0, sizeof(double) * num_threads);
+}
+
+/*
+This method starts the metrics of a search of groupSize control entries
+*/
+void startMetrics(int groupSize)
+{
+	memset(&metrics, 0, sizeof(searchMetrics_));
+	metrics.groupSize = groupSize;
+	resetThreadSearchTimes();
+}
+
+/*
+This method writes the metrics of the current control entry if --metrics was given
+*/
+void recordMetrics()
+{
+	if (metricsFile == NULL)
+		return;
+	metrics.numWorkers = num_threads;
+	metrics.workerSearchSeconds = threadSearchTime;
+	writeMetrics(metricsFile, textNumber, patternNumber, typeOfRead, &metrics);
 }
 
 /*
 This method is a modified version of the original hostMatch, it will store
-all positions at which a pattern is found in a linked list, accessed via a 
-critical section in the parallel for loop. This method is only used when the 
+all positions at which a pattern is found in ascending order. The start positions are split into blocks
+and each block is searched by the engine chosen with --engine=. Each thread records its matches in its
+own growable array and notes where each block's matches start, so no critical section is needed. At the
+end the blocks are concatenated in order, in parallel, into one sorted array. This method is only used when the 
 search type is a '1' ie. When all occurances of a pattern need to be found.
 */
-linkedList_* hostMatchFindAll()
+positionList_ hostMatchFindAll()
 {
 	//Declare variables that are needed for parallel execution
-	int startPos,matchingCounter,currentPos, endPos, counter;
-	bool isMatching;
-	linkedList_* foundAtList;
-	foundAtList = (linkedList_*) malloc(sizeof(linkedList_)); //allocate memory for linked list object
-    foundAtList->next = NULL; //set linked list initial values
-    foundAtList->index = -1;
+	int block, numBlocks;
+	long long endPos;
+	positionList_ foundAtList = {NULL, 0, 0};
+	positionList_ *threadResults = (positionList_ *) calloc(num_threads, sizeof(positionList_)); //one array of matches per thread
 	
 	//Initialise all shared and firstprivate variables 
-	matchingCounter=0;
 	endPos = textLength-patternLength;
-	isMatching = false;
-
-	//Parallel openmp for loop 
-	#pragma omp parallel for shared(foundAtList) firstprivate(endPos,patternLength, textData, patternData, isMatching, matchingCounter) private(startPos, currentPos) num_threads(num_threads) schedule(guided)
-	for(startPos = 0; startPos<=endPos; startPos++)
-	{
-		if (textData[startPos] == patternData[0])
-		{ //if the start position of this iteration finds a match for the first letter in the pattern 
-			isMatching = true; 
-			currentPos = startPos;
-		}
-		while (isMatching && matchingCounter < patternLength) 
-		{ //while the text is matching the pattern, this while loop will iterate through the text until it finds a full pattern match
-			if (textData[currentPos] == patternData[matchingCounter])
-			{//checks if the text is still matching the pattern
-				currentPos++;
-				matchingCounter++;
-				if (matchingCounter == patternLength) 
-				{ //If a full pattern match is found the then the startPos is pushed to the linked list 
-					#pragma omp critical (found)
-					{//Needs to be in ciritical section as multiple occurances of the pattern may appear in the text
-						pushToList(&foundAtList, startPos); //pushes the most recently found pattern position to the linked list
-					}
-					isMatching = false;
-					matchingCounter = 0;
-				}
-			}
-			else
-			{ //The text is no longer matching the pattern, so the relevant variables are reset to 0/false
-				currentPos=0;
-				matchingCounter=0;
-				isMatching = false;
-			}
+	numBlocks = (int) (endPos / SEARCH_BLOCK_SIZE + 1);
+	int *blockThread = (int *) malloc(sizeof(int) * numBlocks); //thread that searched each block
+	long long *blockStart = (long long *) malloc(sizeof(long long) * numBlocks); //where the block's matches start in that thread's array
+	long long *blockCount = (long long *) malloc(sizeof(long long) * numBlocks); //number of matches in the block
+	long long *blockOffset = (long long *) malloc(sizeof(long long) * numBlocks); //where the block's matches go in the final array
+	if (threadResults == NULL || blockThread == NULL || blockStart == NULL || blockCount == NULL || blockOffset == NULL)
+		outOfMemory();
+	resetThreadSearchTimes();
+
+	//Parallel openmp for loop over the blocks of start positions
+	#pragma omp parallel for shared(threadResults, blockThread, blockStart, blockCount, engine) firstprivate(endPos, textData) private(block) num_threads(num_threads) schedule(guided)
+	for(block = 0; block < numBlocks; block++)
+	{
+		long long startPos;
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		positionList_ *myResults = &threadResults[omp_get_thread_num()];
+		searchCursor_ cursor;
+		if (lastPos > endPos)
+		{ //the last block stops at the last position the pattern could start
+			lastPos = endPos;
+		}
+
+		double searchStart = omp_get_wtime();
+		blockThread[block] = omp_get_thread_num();
+		blockStart[block] = myResults->count;
+		startSearchCursor(&cursor, firstPos);
+		while ((startPos = searchEngineNext(&engine, textData, lastPos, &cursor)) != -1)
+		{ //If a full pattern match is found the then the startPos is added to this thread's array
+			pushPosition(myResults, startPos);
 		}
+		blockCount[block] = myResults->count - blockStart[block];
+		threadSearchTime[omp_get_thread_num()] += omp_get_wtime() - searchStart;
+	}
+
+	//work out where each block goes in the final array, the engines find positions in order within a block
+	for (block = 0; block < numBlocks; block++)
+	{
+		blockOffset[block] = foundAtList.count;
+		foundAtList.count += blockCount[block];
 	}
+	foundAtList.allocated = foundAtList.count;
+	if (foundAtList.count > 0)
+	{
+		foundAtList.positions = (long long *) malloc(sizeof(long long) * foundAtList.count);
+		if (foundAtList.positions == NULL)
+			outOfMemory();
+
+		//copy the blocks into place in parallel
+		#pragma omp parallel for shared(foundAtList, threadResults, blockThread, blockStart, blockCount, blockOffset) private(block) num_threads(num_threads) schedule(static)
+		for (block = 0; block < numBlocks; block++)
+		{
+			memcpy(foundAtList.positions + blockOffset[block], threadResults[blockThread[block]].positions + blockStart[block], sizeof(long long) * blockCount[block]);
+		}
+	}
+
+	for (int t = 0; t < num_threads; t++)
+		freePositions(&threadResults[t]);
+	free(threadResults);
+	free(blockThread);
+	free(blockStart);
+	free(blockCount);
+	free(blockOffset);
 	return foundAtList;
 }
 
@@ -211,123 +426,1056 @@ linkedList_* hostMatchFindAll()
 This method creates a parallel for loop which searches for a pattern, it will return -2
 if the pattern exits in the text and -1 if it does now. This method is only used when the 
 search type is '0' ie. When finding if a pattern exists in the text.
+The loop is cancellable: the first thread to find the pattern publishes it with an atomic release
+store and cancels the loop. Every other thread checks the flag with an atomic acquire load before each
+block, so at most one block per thread is searched after the first hit even when cancellation is disabled.
 */
 int hostMatchFindExists()
 {
     //Declare variables that are needed for parallel execution
-	int startPos,matchingCounter,currentPos, endPos, isFound, counter;
-	bool isMatching;
+	int block, numBlocks, isFound;
+	long long endPos;
 	
 	//Initialise all shared and firstprivate variables 
-	matchingCounter=0;
 	isFound = -1;
 	endPos = textLength-patternLength;
-	isMatching = false;
-
-	//Parallel openmp for loop 
-	#pragma omp parallel for shared(isFound) firstprivate(endPos,patternLength, textData, patternData, isMatching, matchingCounter) private(startPos, currentPos) num_threads(num_threads) schedule(static)
-	for(startPos = 0; startPos<=endPos; startPos++)
-	{
-		if (isFound == -1 && textData[startPos] == patternData[0])
-		{ //if the start position of this iteration finds a match for the first letter in the pattern 
-			isMatching = true; 
-			currentPos = startPos;
-		}
-		while (isFound == -1  && isMatching && matchingCounter < patternLength) 
-		{ //while the text is matching the pattern this while loop will iterate through the text until it finds a full pattern match or 
-			if (textData[currentPos] == patternData[matchingCounter])
-			{//checks if the text is still matching the pattern
-				currentPos++;
-				matchingCounter++;
-				if (matchingCounter == patternLength) 
-				{ //If a full pattern match is found the isFound shared variable is set to -2
-                    #pragma omp critical (found)
-		            { 
-                        isFound = -2;
-		            }
-					isMatching = false;
-					matchingCounter = 0;
-				}
+	numBlocks = (int) (endPos / SEARCH_BLOCK_SIZE + 1);
+	resetThreadSearchTimes();
+
+	//Parallel openmp region with a for loop over the blocks of start positions, kept separate so the loop can be cancelled
+	#pragma omp parallel shared(isFound, engine) firstprivate(endPos, textData) private(block) num_threads(num_threads)
+	{
+		#pragma omp for schedule(static)
+		for(block = 0; block < numBlocks; block++)
+		{
+			long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+			long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+			searchCursor_ cursor;
+			if (lastPos > endPos)
+			{ //the last block stops at the last position the pattern could start
+				lastPos = endPos;
 			}
-			else
-			{ //The text is no longer matching the pattern, so the relevant variables are reset to 0/false
-				currentPos=0;
-				matchingCounter=0;
-				isMatching = false;
+
+			//stop here if another thread has cancelled the loop (only takes effect when OMP_CANCELLATION=true)
+			#pragma omp cancellation point for
+
+			int found;
+			#pragma omp atomic read acquire
+			found = isFound;
+			if (found == -1)
+			{ //blocks are skipped once any thread has found the pattern
+				double searchStart = omp_get_wtime();
+				startSearchCursor(&cursor, firstPos);
+				long long startPos = searchEngineNext(&engine, textData, lastPos, &cursor);
+				threadSearchTime[omp_get_thread_num()] += omp_get_wtime() - searchStart;
+				if (startPos != -1)
+				{ //If a full pattern match is found the isFound shared variable is set to -2 and the loop is cancelled
+					#pragma omp atomic write release
+					isFound = -2;
+					#pragma omp cancel for
+				}
 			}
 		}
 	}
 	return isFound;
 }
 
+/*
+This method counts the positions at which the pattern is found without storing them. The blocks are
+searched as in hostMatchFindAll, each thread counts the matches in its own blocks and the counts are
+summed with an OpenMP reduction. This method is only used when the search type is '2'.
+*/
+long long hostMatchCount()
+{
+	int block, numBlocks;
+	long long endPos, count;
+
+	count = 0;
+	endPos = textLength-patternLength;
+	numBlocks = (int) (endPos / SEARCH_BLOCK_SIZE + 1);
+	resetThreadSearchTimes();
+
+	#pragma omp parallel for shared(engine) firstprivate(endPos, textData) private(block) reduction(+:count) num_threads(num_threads) schedule(guided)
+	for(block = 0; block < numBlocks; block++)
+	{
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		searchCursor_ cursor;
+		if (lastPos > endPos)
+		{ //the last block stops at the last position the pattern could start
+			lastPos = endPos;
+		}
+
+		double searchStart = omp_get_wtime();
+		startSearchCursor(&cursor, firstPos);
+		while (searchEngineNext(&engine, textData, lastPos, &cursor) != -1)
+			count++;
+		threadSearchTime[omp_get_thread_num()] += omp_get_wtime() - searchStart;
+	}
+	return count;
+}
+
+/*
+This method reports the result of a type '0' search and writes it to the output file
+*/
+void reportFindExists(int result)
+{
+    if (result == -1)
+    {
+        printf ("Pattern not found\n");
+        insertLineInFile(result);
+    }
+    else
+    {
+        printf ("Pattern found \n");
+        insertLineInFile(result);
+    }
+}
+
+/*
+This method reports the result of a type '1' search and writes every position to the output file in ascending order
+*/
+void reportFindAll(positionList_ *allOccurances)
+{
+    if (allOccurances->count == 0)
+    { //if no pattern was found then -1 is written as the result
+        printf ("Pattern not found\n");
+        insertLineInFile(-1);
+    } else {
+        printf ("Pattern found at indexes:\n");
+    }
+    
+    for (long long i = 0; i < allOccurances->count; i++) 
+    { //iterate through the array and print the positions of all of the indexes
+        printf("%lld, ", allOccurances->positions[i]);
+        insertLineInFile(allOccurances->positions[i]);
+    }
+
+    printf ("# of patterns found = %lld\n", allOccurances->count);
+}
+
+/*
+This method reports the result of a type '2' search and writes the count to the output file
+*/
+void reportCount(long long count)
+{
+    printf ("# of patterns found = %lld\n", count);
+    insertLineInFile(count);
+}
+
+/*
+This method reports a search that was skipped because a file is empty or the pattern is longer than the text,
+which is a count of 0 for a type '2' search
+*/
+void reportSkippedSearch()
+{
+    insertLineInFile(typeOfRead == '2' ? 0 : -1);
+    printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
+}
 
 void processData()
 {
-	unsigned int result;
+	int result;
 
-	printf ("Text length = %d\n", textLength);
-    printf ("Pattern length = %d\n", patternLength);
+	printf ("Text length = %lld\n", textLength);
+    printf ("Pattern length = %lld\n", patternLength);
 
 	//checks to see if either of the files are empty, or if the pattern is longer than the text
 	//if any of these are true, the search is not executed and instead -1 is written to the file as the result
+    double phaseStart = omp_get_wtime();
     if (textLength == 0 || patternLength == 0 || textLength < patternLength)
     {
-        result = -1;
-        insertLineInFile(result);
-		printf("Search skipped due to an empty file, or text file is shorter than pattern file\n");
+        reportSkippedSearch();
+        metrics.writeSeconds = omp_get_wtime() - phaseStart;
         return;
     }
 
+    prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+    metrics.prepareSeconds = omp_get_wtime() - phaseStart;
+
+    phaseStart = omp_get_wtime();
     if(typeOfRead == '0') 
     { //if checking if the pattern exists in the file
         result = hostMatchFindExists(); //do the search
-		//report the results and write them to the output file
-        if (result == -1)
-        {
-            printf ("Pattern not found\n");
-            insertLineInFile(result);
-        }
-	    else
-        {
-            printf ("Pattern found \n");
-            insertLineInFile(result);
-        }
+        metrics.searchSeconds = omp_get_wtime() - phaseStart;
+        metrics.matches = result == -2;
+        phaseStart = omp_get_wtime();
+        reportFindExists(result);
     } else if (typeOfRead == '1')
     { //if finding all occurrances of a pattern in the text
-        linkedList_* allOccurances = hostMatchFindAll();
-        if (allOccurances->index == -1)
-        { //if no pattern was found then the index will still be -1 from the start
-		    printf ("Pattern not found\n");
-            insertLineInFile(allOccurances->index);
-        } else {
-            printf ("Pattern found at indexes:\n");
-        }
-        
-        int counter = 0;
-        while (allOccurances->index != -1) 
-        { //iterate through the linked list and print the positions of all of the indexes
-            counter++;
-            printf("%d, ", allOccurances->index);
-            insertLineInFile(allOccurances->index);
-            allOccurances = allOccurances->next;
-        }
-    
-        printf ("# of patterns found = %d\n", counter);
+        positionList_ allOccurances = hostMatchFindAll();
+        metrics.searchSeconds = omp_get_wtime() - phaseStart;
+        metrics.matches = allOccurances.count;
+        phaseStart = omp_get_wtime();
+        reportFindAll(&allOccurances);
+        freePositions(&allOccurances);
+    } else if (typeOfRead == '2')
+    { //if only counting the occurrences of a pattern
+        long long count = hostMatchCount();
+        metrics.searchSeconds = omp_get_wtime() - phaseStart;
+        metrics.matches = count;
+        phaseStart = omp_get_wtime();
+        reportCount(count);
     }
+    metrics.writeSeconds = omp_get_wtime() - phaseStart;
+}
+
+/*
+This method is used instead of readData and processData when --stream is given, so a text of any size
+can be searched in a fixed amount of memory. The text is never loaded whole: it is read in chunks of
+streamChunkSize start positions, and each chunk is read together with the patternLength - 1 characters
+carried over into the next chunk, so a match spanning the boundary between two chunks is still found.
+The chunks are searched in rounds through a pool of one buffer per thread. In each round every thread
+reads the next chunk into its own buffer with pread and searches it with the engine, then the round's
+matches are written out in chunk order before the next round reuses the buffers. Memory use is fixed at
+num_threads buffers of streamChunkSize + patternLength - 1 bytes, however large the text is. A type '0'
+search stops after the first round that finds the pattern.
+*/
+void streamSearch()
+{
+	char fileName[1000];
+	struct stat fileInfo;
+	double phaseStart = omp_get_wtime();
+	long long chunk, firstChunk, numChunks, lastStart, totalFound;
+	int found, fd;
+
+	sprintf (fileName, "large_inputs/text%s.txt", textNumber);
+	readPattern (patternNumber, &patternData, &patternLength, &patternMapped);
+	fd = open(fileName, O_RDONLY);
+	textLength = fd >= 0 && fstat(fd, &fileInfo) == 0 ? (long long) fileInfo.st_size : 0; //a missing text is treated as empty
+	metrics.loadSeconds = omp_get_wtime() - phaseStart;
+	metrics.textBytes = textLength;
+	metrics.patternBytes = patternLength;
+	printf ("Streaming text file %s in chunks of %d bytes\n", textNumber, streamChunkSize);
+	printf ("Text length = %lld\n", textLength);
+	printf ("Pattern length = %lld\n", patternLength);
+
+	phaseStart = omp_get_wtime();
+	if (textLength == 0 || patternLength == 0 || textLength < patternLength)
+	{ //the search is skipped exactly as in processData
+		reportSkippedSearch();
+		metrics.writeSeconds = omp_get_wtime() - phaseStart;
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+	metrics.prepareSeconds = omp_get_wtime() - phaseStart;
+
+	//one buffer and one array of matches per thread
+	char **buffers = (char **) malloc(sizeof(char *) * num_threads);
+	positionList_ *chunkResults = (positionList_ *) calloc(num_threads, sizeof(positionList_));
+	if (buffers == NULL || chunkResults == NULL)
+		outOfMemory();
+	for (int t = 0; t < num_threads; t++)
+	{
+		buffers[t] = (char *) malloc(sizeof(char) * ((size_t) streamChunkSize + patternLength - 1));
+		if (buffers[t] == NULL)
+			outOfMemory();
+	}
+
+	phaseStart = omp_get_wtime();
+	resetThreadSearchTimes();
+	lastStart = textLength - patternLength;
+	numChunks = lastStart / streamChunkSize + 1;
+	found = 0;
+	totalFound = 0;
+	for (firstChunk = 0; firstChunk < numChunks && !(typeOfRead == '0' && found); firstChunk += num_threads)
+	{
+		//each thread reads and searches one chunk of this round
+		#pragma omp parallel for shared(buffers, chunkResults, engine, found) firstprivate(firstChunk, numChunks, lastStart, fd) private(chunk) num_threads(num_threads) schedule(static, 1)
+		for (chunk = firstChunk; chunk < firstChunk + num_threads; chunk++)
+		{
+			int slot = (int) (chunk - firstChunk);
+			long long chunkStart = chunk * streamChunkSize;
+			long long chunkLast = chunkStart + streamChunkSize - 1;
+			long long startPos;
+			searchCursor_ cursor;
+			chunkResults[slot].count = 0;
+			if (chunk >= numChunks)
+				continue;
+			if (chunkLast > lastStart)
+			{ //the last chunk stops at the last position the pattern could start
+				chunkLast = lastStart;
+			}
+
+			//the chunk's start positions and the characters carried over into the next chunk
+			if (!readFileRange(fd, buffers[slot], chunkStart, chunkLast - chunkStart + patternLength))
+			{
+				fprintf(stderr, "Unable to read text file %s\n", textNumber);
+				exit(1);
+			}
+
+			double searchStart = omp_get_wtime();
+			startSearchCursor(&cursor, 0);
+			while ((startPos = searchEngineNext(&engine, buffers[slot], chunkLast - chunkStart, &cursor)) != -1)
+			{ //positions are stored relative to the start of the text
+				if (typeOfRead == '2')
+				{ //only the number of matches is kept
+					chunkResults[slot].count++;
+					continue;
+				}
+				pushPosition(&chunkResults[slot], chunkStart + startPos);
+				if (typeOfRead == '0')
+					break;
+			}
+			threadSearchTime[omp_get_thread_num()] += omp_get_wtime() - searchStart;
+			if (chunkResults[slot].count > 0)
+			{
+				#pragma omp atomic write
+				found = 1;
+			}
+		}
+
+		//write the round's matches in chunk order, so they stay in ascending order
+		for (int slot = 0; slot < num_threads && typeOfRead != '0'; slot++)
+		{
+			if (typeOfRead == '1' && totalFound == 0 && chunkResults[slot].count > 0)
+				printf ("Pattern found at indexes:\n");
+			for (long long i = 0; i < chunkResults[slot].count && typeOfRead == '1'; i++)
+			{
+				printf("%lld, ", chunkResults[slot].positions[i]);
+				insertLineInFile(chunkResults[slot].positions[i]);
+			}
+			totalFound += chunkResults[slot].count;
+		}
+	}
+	metrics.searchSeconds = omp_get_wtime() - phaseStart;
+
+	phaseStart = omp_get_wtime();
+	if (typeOfRead == '0')
+	{
+		reportFindExists(found ? -2 : -1);
+		metrics.matches = found;
+	} else if (typeOfRead == '2')
+	{
+		reportCount(totalFound);
+		metrics.matches = totalFound;
+	} else
+	{
+		if (totalFound == 0)
+		{ //if no pattern was found then -1 is written as the result
+			printf ("Pattern not found\n");
+			insertLineInFile(-1);
+		}
+		printf ("# of patterns found = %lld\n", totalFound);
+		metrics.matches = totalFound;
+	}
+	metrics.writeSeconds = omp_get_wtime() - phaseStart;
+
+	for (int t = 0; t < num_threads; t++)
+	{
+		free(buffers[t]);
+		freePositions(&chunkResults[t]);
+	}
+	free(buffers);
+	free(chunkResults);
+	close(fd);
 }
 
 void doSearch() 
 {
+    if (streamText)
+    { //the text is read a chunk at a time while it is searched
+        startMetrics(1);
+        streamSearch();
+        recordMetrics();
+        return;
+    }
+
+    double loadStart = omp_get_wtime();
+    startMetrics(1);
     readData();
+    metrics.loadSeconds = omp_get_wtime() - loadStart;
+    metrics.textBytes = textLength;
+    metrics.patternBytes = patternLength;
    	processData();
+    recordMetrics();
+}
+
+typedef struct groupSearch
+{ //results of searching a text for a group of patterns at once, one slot per control entry in the group
+	char *types; //type of search for each entry
+	int *keywordEntry; //entry that each keyword in the automaton belongs to
+	int *exists; //-2 if the entry's pattern has been found, otherwise -1
+	positionList_ *threadFoundAt; //positions found by each thread for each entry, indexed [thread * numEntries + entry]
+	positionList_ *foundAt; //every position the entry's pattern was found at in ascending order, for type '1' entries
+	long long *threadCounts; //matches counted by each thread for each type '2' entry, indexed like threadFoundAt
+	long long *counts; //matches of each type '2' entry, summed over the threads
+	int numEntries;
+	int numFindAll; //number of type '1' and '2' entries, these always need the full text scanned
+	int remainingExists; //number of type '0' entries whose pattern has not been found yet
+} groupSearch_;
+
+/*
+This method is called by the automaton for every pattern occurrence found during a group search.
+It returns false once every entry in the group has its answer so the scan can stop early.
+*/
+bool recordGroupMatch(void *context, int keyword, long long startPos)
+{
+	groupSearch_ *results = (groupSearch_ *) context;
+	int entry = results->keywordEntry[keyword];
+	int remainingExists;
+	if (results->types[entry] == '1')
+	{ //each thread records matches in its own array for the entry, so no locking is needed
+		pushPosition(&results->threadFoundAt[omp_get_thread_num() * results->numEntries + entry], startPos);
+	}
+	else if (results->types[entry] == '2')
+	{ //only counted, in the thread's own counter
+		results->threadCounts[omp_get_thread_num() * results->numEntries + entry]++;
+	}
+	else
+	{ //type '0', the unlocked check lets threads skip the critical section once the pattern has been found
+		int exists;
+		#pragma omp atomic read
+		exists = results->exists[entry];
+		if (exists == -1)
+		{
+			#pragma omp critical (found)
+			{
+				if (results->exists[entry] == -1)
+				{ //only the first thread to find this pattern counts it
+					#pragma omp atomic write
+					results->exists[entry] = -2;
+					#pragma omp atomic update
+					results->remainingExists--;
+				}
+			}
+		}
+	}
+	#pragma omp atomic read acquire
+	remainingExists = results->remainingExists;
+	return results->numFindAll > 0 || remainingExists > 0;
+}
+
+/*
+This method searches the text for every pattern in the automaton in one pass. The start positions
+are split into blocks across the threads, and each block is scanned past its end by the longest
+pattern length so matches crossing a block boundary are found. The schedule is static so each thread
+searches one contiguous run of blocks in thread order, which means each entry's positions come out
+sorted by concatenating the threads' arrays in thread order.
+*/
+void hostMatchGroup(ahoCorasick_ *automaton, groupSearch_ *results)
+{
+	int block, numBlocks;
+	long long endPos;
+	endPos = textLength - automaton->minKeywordLength;
+	numBlocks = (int) (endPos / SEARCH_BLOCK_SIZE + 1);
+	resetThreadSearchTimes();
+
+	#pragma omp parallel for shared(automaton, results) firstprivate(endPos, textData) private(block) num_threads(num_threads) schedule(static)
+	for(block = 0; block < numBlocks; block++)
+	{
+		long long firstPos = (long long) block * SEARCH_BLOCK_SIZE;
+		long long lastPos = firstPos + SEARCH_BLOCK_SIZE - 1;
+		if (lastPos > endPos)
+		{
+			lastPos = endPos;
+		}
+
+		int remainingExists;
+		#pragma omp atomic read acquire
+		remainingExists = results->remainingExists;
+		if (results->numFindAll > 0 || remainingExists > 0)
+		{ //blocks are skipped once every entry in the group has its answer
+			double searchStart = omp_get_wtime();
+			scanAhoCorasick(automaton, textData, firstPos, lastPos, textLength, recordGroupMatch, results);
+			threadSearchTime[omp_get_thread_num()] += omp_get_wtime() - searchStart;
+		}
+	}
+
+	//concatenate each entry's per-thread arrays in thread order, one entry per iteration
+	#pragma omp parallel for shared(results) num_threads(num_threads) schedule(dynamic)
+	for (int entry = 0; entry < results->numEntries; entry++)
+	{
+		positionList_ *merged = &results->foundAt[entry];
+		long long total = 0;
+		for (int t = 0; t < num_threads; t++)
+			results->counts[entry] += results->threadCounts[t * results->numEntries + entry];
+		for (int t = 0; t < num_threads; t++)
+			total += results->threadFoundAt[t * results->numEntries + entry].count;
+		if (total == 0)
+			continue;
+
+		merged->positions = (long long *) malloc(sizeof(long long) * total);
+		if (merged->positions == NULL)
+			outOfMemory();
+		merged->allocated = total;
+		for (int t = 0; t < num_threads; t++)
+		{
+			positionList_ *part = &results->threadFoundAt[t * results->numEntries + entry];
+			memcpy(merged->positions + merged->count, part->positions, sizeof(long long) * part->count);
+			merged->count += part->count;
+			freePositions(part);
+		}
+	}
+}
+
+/*
+This method makes control entry i the current search
+*/
+void selectEntry(int i)
+{
+	typeOfRead = controlEntries[i].typeOfRead;
+	textNumber = controlEntries[i].textNumber;
+	patternNumber = controlEntries[i].patternNumber;
+	controlEntries[i].done = true;
+}
+
+/*
+This method collects entry i and every later entry that uses the same text into group,
+and returns the number of entries in the group.
+*/
+int collectGroup(int i, int *group)
+{
+	int groupSize = 0;
+	for (int j = i; j < numControlEntries; j++)
+	{
+		if (!controlEntries[j].done && strcmp(controlEntries[j].textNumber, controlEntries[i].textNumber) == 0)
+		{
+			group[groupSize++] = j;
+		}
+	}
+	return groupSize;
+}
+
+/*
+This method searches a group of control entries that all use the same text. The text is loaded once
+and every pattern in the group is searched for in a single Aho-Corasick pass (see aho_corasick.h).
+Each entry's result is then written to the output file exactly as doSearch would have written it.
+*/
+void doGroupSearch(int *group, int groupSize)
+{
+	char **patterns = (char **) malloc(sizeof(char *) * groupSize);
+	long long *lengths = (long long *) malloc(sizeof(long long) * groupSize);
+	bool *mapped = (bool *) malloc(sizeof(bool) * groupSize);
+	char **keywords = (char **) malloc(sizeof(char *) * groupSize);
+	int *keywordLengths = (int *) malloc(sizeof(int) * groupSize);
+	int numKeywords = 0;
+	groupSearch_ results;
+	ahoCorasick_ automaton;
+
+	results.types = (char *) malloc(sizeof(char) * groupSize);
+	results.keywordEntry = (int *) malloc(sizeof(int) * groupSize);
+	results.exists = (int *) malloc(sizeof(int) * groupSize);
+	results.numEntries = groupSize;
+	results.threadFoundAt = (positionList_ *) calloc((size_t) num_threads * groupSize, sizeof(positionList_));
+	results.foundAt = (positionList_ *) calloc(groupSize, sizeof(positionList_));
+	results.threadCounts = (long long *) calloc((size_t) num_threads * groupSize, sizeof(long long));
+	results.counts = (long long *) calloc(groupSize, sizeof(long long));
+	if (results.threadFoundAt == NULL || results.foundAt == NULL || results.threadCounts == NULL || results.counts == NULL)
+		outOfMemory();
+	results.numFindAll = 0;
+	results.remainingExists = 0;
+
+	//load the shared text once and every pattern in the group
+	startMetrics(groupSize);
+	double loadStart = omp_get_wtime();
+	double bytesLoaded;
+	textNumber = controlEntries[group[0]].textNumber;
+	readText();
+	bytesLoaded = textLength;
+	for (int k = 0; k < groupSize; k++)
+	{
+		readPattern(controlEntries[group[k]].patternNumber, &patterns[k], &lengths[k], &mapped[k]);
+		bytesLoaded += lengths[k];
+	}
+	reportLoadThroughput(loadStart, bytesLoaded);
+	metrics.loadSeconds = omp_get_wtime() - loadStart;
+	metrics.textBytes = textLength;
+	printf ("\nSearching text file %s for %d patterns in a single pass\n", textNumber, groupSize);
+	printf ("Text length = %lld\n", textLength);
+
+	for (int k = 0; k < groupSize; k++)
+	{
+		results.types[k] = controlEntries[group[k]].typeOfRead;
+		results.exists[k] = -1;
+		if (textLength == 0 || lengths[k] == 0 || textLength < lengths[k])
+		{ //patterns that can not be found are left out of the automaton
+			continue;
+		}
+		keywords[numKeywords] = patterns[k];
+		keywordLengths[numKeywords] = (int) lengths[k]; //patterns are always far shorter than 2GB
+		results.keywordEntry[numKeywords] = k;
+		numKeywords++;
+		if (results.types[k] != '0')
+			results.numFindAll++;
+		else
+			results.remainingExists++;
+	}
+
+	if (numKeywords > 0)
+	{
+		double phaseStart = omp_get_wtime();
+		if (!buildAhoCorasick(&automaton, keywords, keywordLengths, numKeywords))
+			outOfMemory();
+		metrics.prepareSeconds = omp_get_wtime() - phaseStart;
+		phaseStart = omp_get_wtime();
+		hostMatchGroup(&automaton, &results);
+		metrics.searchSeconds = omp_get_wtime() - phaseStart;
+		freeAhoCorasick(&automaton);
+	}
+
+	//report each entry's result in the same format as an individual search
+	for (int k = 0; k < groupSize; k++)
+	{
+		double writeStart = omp_get_wtime();
+		selectEntry(group[k]);
+		printf ("\nPattern file %s, pattern length = %lld\n", patternNumber, lengths[k]);
+		if (textLength == 0 || lengths[k] == 0 || textLength < lengths[k])
+			reportSkippedSearch();
+		else if (typeOfRead == '0')
+			reportFindExists(results.exists[k]);
+		else if (typeOfRead == '1')
+			reportFindAll(&results.foundAt[k]);
+		else if (typeOfRead == '2')
+			reportCount(results.counts[k]);
+		metrics.writeSeconds = omp_get_wtime() - writeStart;
+		metrics.patternBytes = lengths[k];
+		metrics.matches = typeOfRead == '0' ? results.exists[k] == -2 : typeOfRead == '2' ? results.counts[k] : results.foundAt[k].count;
+		recordMetrics();
+		freePositions(&results.foundAt[k]);
+		releaseFile(patterns[k], lengths[k], mapped[k]);
+	}
+	releaseFile(textData, textLength, textMapped);
+	textData = NULL;
+	textMapped = false;
+
+	free(patterns);
+	free(lengths);
+	free(mapped);
+	free(keywords);
+	free(keywordLengths);
+	free(results.types);
+	free(results.keywordEntry);
+	free(results.exists);
+	free(results.threadFoundAt);
+	free(results.foundAt);
+	free(results.threadCounts);
+	free(results.counts);
+}
+
+/*
+This method answers a group of control entries that all use the same text from the text's suffix array
+index (see text_index.h) instead of scanning it. Each pattern is found with a binary search of the index,
+and each entry's result is written exactly as doSearch would have written it. Returns false without
+searching if the text has no index newer than it, or the index does not match the text, so the caller
+can scan the text instead.
+*/
+bool doIndexSearch(int *group, int groupSize)
+{
+	char fileName[1000];
+	char indexName[1000];
+	textIndex_ index;
+	textNumber = controlEntries[group[0]].textNumber;
+	textFileName(fileName, textNumber);
+	indexFileName(indexName, textNumber);
+	if (!textIndexIsFresh(fileName, indexName))
+		return false;
+
+	double loadStart = omp_get_wtime();
+	readText();
+	if (!loadTextIndex(indexName, textLength, &index))
+	{ //the index was built from a different text, scan this one instead
+		printf("\nIndex %s does not match text file %s, scanning the text\n", indexName, textNumber);
+		releaseFile(textData, textLength, textMapped);
+		textData = NULL;
+		textMapped = false;
+		return false;
+	}
+	double loadSeconds = omp_get_wtime() - loadStart;
+	printf ("\nSearching text file %s for %d pattern(s) using its suffix array index\n", textNumber, groupSize);
+	printf ("Text length = %lld\n", textLength);
+
+	for (int k = 0; k < groupSize; k++)
+	{
+		startMetrics(groupSize);
+		metrics.loadSeconds = loadSeconds;
+		metrics.textBytes = textLength;
+		selectEntry(group[k]);
+		double phaseStart = omp_get_wtime();
+		readPattern(patternNumber, &patternData, &patternLength, &patternMapped);
+		metrics.loadSeconds += omp_get_wtime() - phaseStart;
+		metrics.patternBytes = patternLength;
+		printf ("\nPattern file %s, pattern length = %lld\n", patternNumber, patternLength);
+
+		phaseStart = omp_get_wtime();
+		if (textLength == 0 || patternLength == 0 || textLength < patternLength)
+		{
+			reportSkippedSearch();
+		} else if (typeOfRead == '0')
+		{
+			int result = indexFindExists(&index, textData, patternData, patternLength);
+			metrics.searchSeconds = omp_get_wtime() - phaseStart;
+			metrics.matches = result == -2;
+			phaseStart = omp_get_wtime();
+			reportFindExists(result);
+		} else if (typeOfRead == '1')
+		{
+			positionList_ allOccurances = {NULL, 0, 0};
+			allOccurances.count = indexFindAll(&index, textData, patternData, patternLength, &allOccurances.positions);
+			if (allOccurances.count < 0)
+				outOfMemory();
+			allOccurances.allocated = allOccurances.count;
+			metrics.searchSeconds = omp_get_wtime() - phaseStart;
+			metrics.matches = allOccurances.count;
+			phaseStart = omp_get_wtime();
+			reportFindAll(&allOccurances);
+			freePositions(&allOccurances);
+		} else if (typeOfRead == '2')
+		{ //the occurrences are next to each other in the index, so they are counted without being looked at
+			long long count = indexCount(&index, textData, patternData, patternLength);
+			metrics.searchSeconds = omp_get_wtime() - phaseStart;
+			metrics.matches = count;
+			phaseStart = omp_get_wtime();
+			reportCount(count);
+		}
+		metrics.writeSeconds = omp_get_wtime() - phaseStart;
+		threadSearchTime[0] = metrics.searchSeconds; //the index is searched by one thread
+		recordMetrics();
+		releaseFile(patternData, patternLength, patternMapped);
+		patternData = NULL;
+		patternMapped = false;
+	}
+	releaseTextIndex(&index);
+	releaseFile(textData, textLength, textMapped);
+	textData = NULL;
+	textMapped = false;
+	return true;
+}
+
+/*
+This method is used by --build-index and --build-filter. For every text named in the control file it builds
+a suffix array (see text_index.h) and a q-gram filter (see qgram_filter.h), as asked for, unless the text
+already has one newer than it, and saves them next to the text.
+*/
+void buildTextIndexes()
+{
+	char fileName[1000];
+	char indexName[1000];
+	char filterName[1000];
+	for (int i = 0; i < numControlEntries; i++)
+	{
+		bool seen = false;
+		for (int j = 0; j < i && !seen; j++)
+			seen = strcmp(controlEntries[j].textNumber, controlEntries[i].textNumber) == 0;
+		textNumber = controlEntries[i].textNumber;
+		textFileName(fileName, textNumber);
+		indexFileName(indexName, textNumber);
+		filterFileName(filterName, textNumber);
+		bool needIndex = buildIndexes && !textIndexIsFresh(fileName, indexName);
+		bool needFilter = buildFilters && !textIndexIsFresh(fileName, filterName);
+		if (seen || (!needIndex && !needFilter))
+		{ //each text is only built for once, and only if what was asked for is missing or older than it
+			continue;
+		}
+
+		readText();
+		if (textLength == 0)
+		{ //nothing can be found in an empty text, so it is not worth an index
+			continue;
+		}
+		if (needIndex)
+		{
+			double buildStart = omp_get_wtime();
+			long long *suffixes;
+			if (!buildSuffixArray(textData, textLength, num_threads, &suffixes))
+				outOfMemory();
+			if (!writeTextIndex(indexName, suffixes, textLength))
+				printf("Unable to write index file %s\n", indexName);
+			else
+				printf("Built index %s for %lld characters in %f seconds\n", indexName, textLength, omp_get_wtime() - buildStart);
+			free(suffixes);
+		}
+		if (needFilter)
+		{
+			double buildStart = omp_get_wtime();
+			unsigned long long *bits = buildQgramFilter(textData, textLength, num_threads);
+			if (bits == NULL)
+				outOfMemory();
+			if (!writeQgramFilter(filterName, bits, textLength))
+				printf("Unable to write filter file %s\n", filterName);
+			else
+				printf("Built filter %s for %lld characters in %f seconds\n", filterName, textLength, omp_get_wtime() - buildStart);
+			free(bits);
+		}
+		releaseFile(textData, textLength, textMapped);
+		textData = NULL;
+		textMapped = false;
+	}
+}
+
+/*
+This method answers every type '0' and '2' entry of a group sharing a text whose pattern the text's q-gram filter
+shows can not occur (see qgram_filter.h). Each of them is reported as not found, or a count of 0, without the text
+being loaded and is removed from the group. Returns the number of entries left to search.
+*/
+int filterGroup(int *group, int groupSize)
+{
+	char fileName[1000];
+	char filterName[1000];
+	qgramFilter_ filter;
+	int remaining = 0;
+	textFileName(fileName, controlEntries[group[0]].textNumber);
+	filterFileName(filterName, controlEntries[group[0]].textNumber);
+	if (!loadFreshQgramFilter(fileName, filterName, &filter))
+		return groupSize;
+
+	for (int k = 0; k < groupSize; k++)
+	{
+		if (controlEntries[group[k]].typeOfRead == '1')
+		{ //every position has to be found, the filter can not help
+			group[remaining++] = group[k];
+			continue;
+		}
+		double phaseStart = omp_get_wtime();
+		readPattern(controlEntries[group[k]].patternNumber, &patternData, &patternLength, &patternMapped);
+		bool allowed = patternLength == 0 || qgramFilterAllows(&filter, patternData, patternLength);
+		double filterSeconds = omp_get_wtime() - phaseStart;
+		if (allowed)
+		{ //the pattern might occur, so the text is searched as normal
+			group[remaining++] = group[k];
+		} else
+		{
+			startMetrics(1);
+			selectEntry(group[k]);
+			metrics.searchSeconds = filterSeconds;
+			metrics.patternBytes = patternLength;
+			printf ("\nPattern file %s can not occur in text file %s, it has a 3-gram the text does not\n", patternNumber, textNumber);
+			phaseStart = omp_get_wtime();
+			if (typeOfRead == '2')
+				reportCount(0);
+			else
+				reportFindExists(-1);
+			metrics.writeSeconds = omp_get_wtime() - phaseStart;
+			recordMetrics();
+		}
+		releaseFile(patternData, patternLength, patternMapped);
+		patternData = NULL;
+		patternMapped = false;
+	}
+	releaseQgramFilter(&filter);
+	return remaining;
+}
+
+typedef struct batchSearch
+{ //one control entry searched as an OpenMP task by --batch, and its result
+	int entry; //index of the entry in controlEntries
+	long long plannedLength; //size of the text file when the batch was planned, larger searches are started first
+	long long textLength;
+	long long patternLength;
+	char typeOfRead;
+	searchEngine_ engine; //prepared from this entry's pattern, shared read-only by its block tasks
+	const char *textData;
+	bool skipped; //a file is empty or the text is shorter than the pattern
+	int exists; //-2 once the pattern has been found, otherwise -1
+	positionList_ foundAt; //every position found in a type '1' search, in ascending order
+	long long count; //number of matches found by a type '2' search
+	double loadSeconds;
+	double searchSeconds;
+} batchSearch_;
+
+int compareBatchSize(const void *a, const void *b)
+{ //largest text first
+	long long lengthA = ((const batchSearch_ *) a)->plannedLength;
+	long long lengthB = ((const batchSearch_ *) b)->plannedLength;
+	return (lengthA < lengthB) - (lengthA > lengthB);
+}
+
+int compareBatchEntry(const void *a, const void *b)
+{ //control file order
+	return ((const batchSearch_ *) a)->entry - ((const batchSearch_ *) b)->entry;
+}
+
+/*
+This method searches the start positions from firstPos to lastPos of a batch search with its engine, adding
+the positions found to found for a type '1' search, adding the number found to count for a type '2' search, or
+setting exists for a type '0' search. A type '0' block is skipped once another block of the same search has
+found the pattern.
+*/
+void searchBatchRange(batchSearch_ *batch, long long firstPos, long long lastPos, positionList_ *found)
+{
+	searchCursor_ cursor;
+	long long startPos;
+	startSearchCursor(&cursor, firstPos);
+	if (batch->typeOfRead == '0')
+	{
+		int exists;
+		#pragma omp atomic read acquire
+		exists = batch->exists;
+		if (exists == -1 && searchEngineNext(&batch->engine, batch->textData, lastPos, &cursor) != -1)
+		{
+			#pragma omp atomic write release
+			batch->exists = -2;
+		}
+	} else if (batch->typeOfRead == '2')
+	{
+		long long count = 0;
+		while (searchEngineNext(&batch->engine, batch->textData, lastPos, &cursor) != -1)
+			count++;
+		#pragma omp atomic update
+		batch->count += count;
+	} else
+	{
+		while ((startPos = searchEngineNext(&batch->engine, batch->textData, lastPos, &cursor)) != -1)
+			pushPosition(found, startPos);
+	}
+}
+
+/*
+This method is the task run for each entry by --batch. It loads the entry's own text and pattern, so entries
+never share state, and searches it. A search of up to BATCH_SPLIT_LENGTH start positions is run whole by the
+thread running the task, as splitting it would cost more than it saves. A larger one is split into block tasks
+of BATCH_SPLIT_LENGTH start positions that any idle thread can pick up, each filling its own array, and the
+arrays are concatenated in block order once they are all done.
+*/
+void searchBatchEntry(batchSearch_ *batch)
+{
+	char fileName[1000];
+	char *text, *pattern;
+	bool textIsMapped, patternIsMapped;
+	double phaseStart = omp_get_wtime();
+	textFileName(fileName, controlEntries[batch->entry].textNumber);
+	if (!loadFile(fileName, &text, &batch->textLength, &textIsMapped))
+	{ //a missing text is treated as empty so the search is skipped
+		text = NULL;
+		batch->textLength = 0;
+		textIsMapped = false;
+	}
+	readPattern(controlEntries[batch->entry].patternNumber, &pattern, &batch->patternLength, &patternIsMapped);
+	batch->loadSeconds = omp_get_wtime() - phaseStart;
+
+	batch->exists = -1;
+	batch->skipped = batch->textLength == 0 || batch->patternLength == 0 || batch->textLength < batch->patternLength;
+	phaseStart = omp_get_wtime();
+	if (!batch->skipped)
+	{
+		long long endPos = batch->textLength - batch->patternLength;
+		batch->textData = text;
+		prepareSearchEngine(&batch->engine, engineType, pattern, (int) batch->patternLength);
+		if (endPos < BATCH_SPLIT_LENGTH)
+		{ //small enough to search whole on this thread
+			searchBatchRange(batch, 0, endPos, &batch->foundAt);
+		} else
+		{
+			long long numBlocks = endPos / BATCH_SPLIT_LENGTH + 1;
+			positionList_ *blockFound = (positionList_ *) calloc(numBlocks, sizeof(positionList_));
+			if (blockFound == NULL)
+				outOfMemory();
+			for (long long block = 0; block < numBlocks; block++)
+			{
+				#pragma omp task firstprivate(batch, block, blockFound, endPos)
+				{
+					long long firstPos = block * BATCH_SPLIT_LENGTH;
+					long long lastPos = firstPos + BATCH_SPLIT_LENGTH - 1;
+					searchBatchRange(batch, firstPos, lastPos < endPos ? lastPos : endPos, &blockFound[block]);
+				}
+			}
+			#pragma omp taskwait
+
+			long long total = 0;
+			for (long long block = 0; block < numBlocks; block++)
+				total += blockFound[block].count;
+			if (total > 0)
+			{
+				batch->foundAt.positions = (long long *) malloc(sizeof(long long) * total);
+				if (batch->foundAt.positions == NULL)
+					outOfMemory();
+				batch->foundAt.allocated = total;
+			}
+			for (long long block = 0; block < numBlocks; block++)
+			{
+				if (blockFound[block].count > 0)
+					memcpy(batch->foundAt.positions + batch->foundAt.count, blockFound[block].positions, sizeof(long long) * blockFound[block].count);
+				batch->foundAt.count += blockFound[block].count;
+				freePositions(&blockFound[block]);
+			}
+			free(blockFound);
+		}
+	}
+	batch->searchSeconds = omp_get_wtime() - phaseStart;
+	batch->textData = NULL;
+	releaseFile(text, batch->textLength, textIsMapped);
+	releaseFile(pattern, batch->patternLength, patternIsMapped);
+}
+
+/*
+This method is used by --batch to search the given control entries as OpenMP tasks. A single parallel region
+is opened for the whole batch and one thread creates a task per entry, largest text first so the long searches
+are not left until the end, and every thread takes tasks as it becomes free. Once they are all done each
+entry's result is written under its own text and pattern, in control file order.
+*/
+void runBatch(int *entries, int numEntries)
+{
+	batchSearch_ *batches = (batchSearch_ *) calloc(numEntries > 0 ? numEntries : 1, sizeof(batchSearch_));
+	char fileName[1000];
+	struct stat fileInfo;
+	if (batches == NULL)
+		outOfMemory();
+	for (int k = 0; k < numEntries; k++)
+	{
+		batches[k].entry = entries[k];
+		batches[k].typeOfRead = controlEntries[entries[k]].typeOfRead;
+		textFileName(fileName, controlEntries[entries[k]].textNumber);
+		batches[k].plannedLength = stat(fileName, &fileInfo) == 0 ? (long long) fileInfo.st_size : 0;
+	}
+	qsort(batches, numEntries, sizeof(batchSearch_), compareBatchSize);
+
+	double batchStart = omp_get_wtime();
+	#pragma omp parallel shared(batches, numEntries) num_threads(num_threads)
+	{
+		#pragma omp single
+		{
+			for (int k = 0; k < numEntries; k++)
+			{
+				#pragma omp task firstprivate(k)
+				searchBatchEntry(&batches[k]);
+			}
+		}
+	}
+	printf("\nSearched %d entries as tasks in %f seconds\n", numEntries, omp_get_wtime() - batchStart);
+
+	qsort(batches, numEntries, sizeof(batchSearch_), compareBatchEntry);
+	for (int k = 0; k < numEntries; k++)
+	{
+		batchSearch_ *batch = &batches[k];
+		double writeStart = omp_get_wtime();
+		selectEntry(batch->entry);
+		printf ("\nText file %s, pattern file %s, text length = %lld, pattern length = %lld\n", textNumber, patternNumber,
+			batch->textLength, batch->patternLength);
+		if (batch->skipped)
+			reportSkippedSearch();
+		else if (typeOfRead == '0')
+			reportFindExists(batch->exists);
+		else if (typeOfRead == '1')
+			reportFindAll(&batch->foundAt);
+		else if (typeOfRead == '2')
+			reportCount(batch->count);
+
+		if (metricsFile != NULL)
+		{ //each entry was searched by whichever threads picked up its tasks, so only its total time is known
+			startMetrics(1);
+			metrics.textBytes = batch->textLength;
+			metrics.patternBytes = batch->patternLength;
+			metrics.matches = typeOfRead == '0' ? batch->exists == -2 : typeOfRead == '2' ? batch->count : batch->foundAt.count;
+			metrics.loadSeconds = batch->loadSeconds;
+			metrics.searchSeconds = batch->searchSeconds;
+			metrics.writeSeconds = omp_get_wtime() - writeStart;
+			metrics.numWorkers = 1;
+			metrics.workerSearchSeconds = &metrics.searchSeconds;
+			writeMetrics(metricsFile, textNumber, patternNumber, typeOfRead, &metrics);
+		}
+		freePositions(&batch->foundAt);
+	}
+	free(batches);
 }
 
 /*
 This method simply prints an entire file, it is used to print the control file to console
 */
-void printFile(char *fileData, int fileLength) 
+void printFile(char *fileData, long long fileLength) 
 {
-     int i;
+     long long i;
      for (i = 0; i < fileLength; i++) {
         printf("%c", fileData[i]);
     }
@@ -356,7 +1504,7 @@ void readControlFile()
 	readFromFile (f, &controlData, &controlLength);
     
     //Print the control file out to console
-    printf("Control Length = %d\n", controlLength);
+    printf("Control Length = %lld\n", controlLength);
     printf("=====Control File=====\n");
     printFile(controlData, controlLength);
     printf("======================\n");
@@ -386,12 +1534,14 @@ void determineSearchType()
     while (counter != 3 && controlToken != NULL)
     {
         if (counter % 3 == 0) 
-        {//The first token in a line is always the type of search to be done, it will always be either a '0' or '1'
+        {//The first token in a line is always the type of search to be done, it will always be either a '0', '1' or '2'
             typeOfRead = controlToken[0];
             if(typeOfRead == '0') {
                 printf ("\nFind if the pattern occurs ");
             } else if (typeOfRead == '1') {
                 printf ("\nFind every position of pattern ");
+            } else if (typeOfRead == '2') {
+                printf ("\nCount the occurrences of pattern ");
             }
         } else if (counter % 3 == 1) 
         { //The second token specifies the text number to use 
@@ -414,22 +1564,393 @@ void determineSearchType()
 	}
 }
 
+/*
+This method reads every entry in the control file into controlEntries so that entries
+which share a text can be searched together
+*/
+void readControlEntries()
+{
+	int allocatedEntries = 16;
+	controlEntries = (controlEntry_ *) malloc(sizeof(controlEntry_) * allocatedEntries);
+	numControlEntries = 0;
+
+	determineSearchType();
+	while (allSearchesDone != 1)
+	{
+		if (numControlEntries == allocatedEntries)
+		{
+			allocatedEntries *= 2;
+			controlEntries = (controlEntry_ *) realloc(controlEntries, sizeof(controlEntry_) * allocatedEntries);
+			if (controlEntries == NULL)
+				outOfMemory();
+		}
+		controlEntries[numControlEntries].typeOfRead = typeOfRead;
+		controlEntries[numControlEntries].textNumber = textNumber;
+		controlEntries[numControlEntries].patternNumber = patternNumber;
+		controlEntries[numControlEntries].done = false;
+		numControlEntries++;
+		determineSearchType();
+	}
+}
+
+/*
+This method reads the command line options. The input directory given by the jobscript is ignored
+as the paths are fixed, so only options starting with -- are looked at.
+*/
+void parseArguments(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--threads=", 10) == 0)
+		{ //number of threads to search with, used by jobscript_scaling.sh to sweep thread counts
+			num_threads = atoi(argv[i] + 10);
+			if (num_threads < 1)
+				num_threads = 1;
+		} else if (strcmp(argv[i], "--stream") == 0)
+		{ //read and search each text a chunk at a time instead of loading it whole
+			streamText = true;
+		} else if (strncmp(argv[i], "--chunk-size=", 13) == 0)
+		{ //number of start positions in each chunk when streaming
+			streamChunkSize = atoi(argv[i] + 13);
+			if (streamChunkSize < 1)
+				streamChunkSize = 1;
+		} else if (strcmp(argv[i], "--batch") == 0)
+		{ //search the control entries as OpenMP tasks instead of one after another
+			batchMode = true;
+		} else if (strcmp(argv[i], "--build-index") == 0)
+		{ //build a suffix array index of every text in the control file before searching
+			buildIndexes = true;
+		} else if (strcmp(argv[i], "--build-filter") == 0)
+		{ //build a q-gram filter of every text in the control file before searching
+			buildFilters = true;
+		} else if (strcmp(argv[i], "--metrics") == 0)
+		{ //write the phase timings of every search to metrics_OMP.csv
+			metricsEnabled = true;
+		} else if (strncmp(argv[i], "--engine=", 9) == 0)
+		{ //choose the search engine used by hostMatchFindExists and hostMatchFindAll
+			if (!parseSearchEngine(argv[i] + 9, &engineType))
+			{
+				fprintf(stderr, "Unknown search engine %s, expected naive, horspool or twoway\n", argv[i] + 9);
+				exit(1);
+			}
+		}
+	}
+	if (batchMode && streamText)
+	{ //batch tasks load their texts whole
+		printf("--batch is ignored with --stream\n");
+		batchMode = false;
+	}
+	printf("Using the %s search engine (%s candidate filter) with %d thread(s)\n", searchEngineName(engineType), simdLevelName(detectSimdLevel()), num_threads);
+}
+
+#ifndef BENCHMARK
 int main(int argc, char **argv)
 {
-	//set up the environment by generating the output file, reading the control file and determining the first search to be done
+	parseArguments(argc, argv);
+	if (metricsEnabled)
+		metricsFile = openMetricsFile("metrics_OMP.csv");
+	//set up the environment by generating the output file, reading the control file and reading every search to be done
     generateOutputFile();	
     readControlFile();
-	determineSearchType();
+	readControlEntries();
+	if (buildIndexes || buildFilters)
+		buildTextIndexes();
 
-	while (allSearchesDone != 1) 
+	int *group = (int *) malloc(sizeof(int) * (numControlEntries > 0 ? numControlEntries : 1));
+	int *batchEntries = (int *) malloc(sizeof(int) * (numControlEntries > 0 ? numControlEntries : 1)); //entries left for runBatch
+	int numBatchEntries = 0;
+	for (int i = 0; i < numControlEntries; i++)
 	{ //continue performing searches until all searches specified in the control file are complete
-		doSearch();
-		free(textData);
-		free(patternData);
-		determineSearchType();
+		if (controlEntries[i].done)
+		{ //already searched as part of an earlier group
+			continue;
+		}
+
+		//texts with an index answer every entry on them from it, however the text would have been searched
+		int groupSize = collectGroup(i, group);
+		if (doIndexSearch(group, groupSize))
+		{
+			continue;
+		}
+
+		//exists searches whose pattern the text's q-gram filter rules out are answered without loading the text
+		groupSize = filterGroup(group, groupSize);
+		if (controlEntries[i].done)
+		{ //entry i was one of them, any other entries left in the group are searched when their turn comes
+			continue;
+		}
+
+		if (batchMode)
+		{ //the rest of the group is searched as tasks once every entry has been looked at
+			for (int k = 0; k < groupSize; k++)
+			{
+				batchEntries[numBatchEntries++] = group[k];
+				controlEntries[group[k]].done = true;
+			}
+			continue;
+		}
+
+		//when streaming every entry is searched on its own, as a group needs the whole text loaded
+		if (streamText)
+			groupSize = 1;
+		if (groupSize == 1)
+		{ //the only search on this text, use the single pattern engine
+			selectEntry(i);
+			doSearch();
+			releaseData();
+		} else
+		{ //several searches share this text, answer them all with one pass
+			doGroupSearch(group, groupSize);
+		}
 	}
+	if (numBatchEntries > 0)
+		runBatch(batchEntries, numBatchEntries);
+	free(group);
+	free(batchEntries);
 
 	//close the output file and terminate the program
     fclose(outputFile);
+	if (metricsFile != NULL)
+		fclose(metricsFile);
     return 0;
 }
+#endif
+
+#ifdef BENCHMARK
+////////////////////////////////////////////////////////////////////////////////
+// KERNEL BENCHMARK - built with -DBENCHMARK (see jobscript_benchmark.sh)
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Building with -DBENCHMARK replaces main with a micro-benchmark of the search kernels. No files are read:
+each text and pattern is generated in memory from a fixed seed, so the numbers only measure
+hostMatchFindExists, hostMatchFindAll and hostMatchCount and can be compared between releases and machines.
+
+The corpus is set with --corpus=random|worst, --size=, --alphabet=, --pattern-length= and --density=.
+A random corpus draws the text and pattern uniformly from the first --alphabet= lowercase letters.
+The worst corpus is the naive worst case, a text of all 'a' and a pattern of 'a's ending in 'b', so every
+start position matches all but the last character. --density= plants that many extra copies of the
+pattern per MB of text, evenly spaced.
+
+Every engine (or only the one given with --engine=) is run for all three types of search over each thread
+count in --threads= (a comma separated list, by default 1, 2, 4... up to the number of cores). Each run
+is repeated --reps= times after one untimed warm up run, and one CSV line is printed with the mean and
+standard deviation of the time, the throughput in GB/s and the matches found per second.
+*/
+
+typedef struct benchmarkOptions
+{
+	char corpus[16];
+	long long size;
+	int alphabet;
+	int patternLength;
+	double density; //extra copies of the pattern planted per MB of text
+	int reps;
+	int threadCounts[64];
+	int numThreadCounts;
+	bool allEngines;
+} benchmarkOptions_;
+
+/*
+This method returns the next number from a xorshift generator, so the corpus is the same on every machine
+*/
+unsigned int nextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/*
+This method generates the text and pattern for the benchmark into textData and patternData
+*/
+void generateCorpus(benchmarkOptions_ *options)
+{
+	unsigned int seed = 2463534242u;
+	textLength = options->size;
+	patternLength = options->patternLength;
+	textData = (char *) malloc(sizeof(char) * (textLength > 0 ? textLength : 1));
+	patternData = (char *) malloc(sizeof(char) * (patternLength > 0 ? patternLength : 1));
+	if (textData == NULL || patternData == NULL)
+		outOfMemory();
+
+	if (strcmp(options->corpus, "worst") == 0)
+	{ //every start position matches all but the last character of the pattern
+		memset(textData, 'a', textLength);
+		memset(patternData, 'a', patternLength);
+		patternData[patternLength - 1] = 'b';
+	} else
+	{ //uniformly random over the alphabet
+		for (long long i = 0; i < textLength; i++)
+			textData[i] = 'a' + nextRandom(&seed) % options->alphabet;
+		for (int i = 0; i < patternLength; i++)
+			patternData[i] = 'a' + nextRandom(&seed) % options->alphabet;
+	}
+
+	if (options->density > 0)
+	{ //plant copies of the pattern evenly through the text
+		double gap = (1024.0 * 1024.0) / options->density;
+		if (gap < patternLength)
+			gap = patternLength;
+		for (double position = 0; position + patternLength <= textLength; position += gap)
+			memcpy(textData + (long long) position, patternData, patternLength);
+	}
+}
+
+/*
+This method reads a comma separated list of thread counts
+*/
+void parseThreadCounts(char *list, benchmarkOptions_ *options)
+{
+	options->numThreadCounts = 0;
+	for (char *token = strtok(list, ","); token != NULL && options->numThreadCounts < 64; token = strtok(NULL, ","))
+	{
+		int threads = atoi(token);
+		if (threads > 0)
+			options->threadCounts[options->numThreadCounts++] = threads;
+	}
+}
+
+/*
+This method reads the benchmark's command line options, anything not given keeps its default
+*/
+void parseBenchmarkArguments(int argc, char **argv, benchmarkOptions_ *options)
+{
+	strcpy(options->corpus, "random");
+	options->size = 64 * 1024 * 1024;
+	options->alphabet = 4;
+	options->patternLength = 16;
+	options->density = 0;
+	options->reps = 5;
+	options->allEngines = true;
+	options->numThreadCounts = 0;
+	for (int threads = 1; threads <= omp_get_num_procs() && options->numThreadCounts < 64; threads *= 2)
+		options->threadCounts[options->numThreadCounts++] = threads;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--corpus=", 9) == 0)
+			snprintf(options->corpus, sizeof(options->corpus), "%s", argv[i] + 9);
+		else if (strncmp(argv[i], "--size=", 7) == 0)
+			options->size = atoll(argv[i] + 7);
+		else if (strncmp(argv[i], "--alphabet=", 11) == 0)
+			options->alphabet = atoi(argv[i] + 11);
+		else if (strncmp(argv[i], "--pattern-length=", 17) == 0)
+			options->patternLength = atoi(argv[i] + 17);
+		else if (strncmp(argv[i], "--density=", 10) == 0)
+			options->density = atof(argv[i] + 10);
+		else if (strncmp(argv[i], "--reps=", 7) == 0)
+			options->reps = atoi(argv[i] + 7);
+		else if (strncmp(argv[i], "--threads=", 10) == 0)
+			parseThreadCounts(argv[i] + 10, options);
+		else if (strncmp(argv[i], "--engine=", 9) == 0)
+		{ //only benchmark one engine
+			if (!parseSearchEngine(argv[i] + 9, &engineType))
+			{
+				fprintf(stderr, "Unknown search engine %s, expected naive, horspool or twoway\n", argv[i] + 9);
+				exit(1);
+			}
+			options->allEngines = false;
+		}
+	}
+
+	if (options->alphabet < 1 || options->alphabet > 26)
+		options->alphabet = 4;
+	if (options->reps < 1)
+		options->reps = 1;
+	if (options->patternLength < 1 || options->patternLength > options->size)
+	{
+		fprintf(stderr, "--pattern-length= must be between 1 and --size=\n");
+		exit(1);
+	}
+}
+
+/*
+This method runs one type of search once with the current engine and thread count, returning the
+number of matches (1 or 0 for a type '0' search) and setting seconds to the time it took
+*/
+long long runKernel(char type, double *seconds)
+{
+	long long matches;
+	double start = omp_get_wtime();
+	if (type == '0')
+	{
+		matches = hostMatchFindExists() == -2;
+	} else if (type == '2')
+	{
+		matches = hostMatchCount();
+	} else
+	{
+		positionList_ allOccurances = hostMatchFindAll();
+		matches = allOccurances.count;
+		freePositions(&allOccurances);
+	}
+	*seconds = omp_get_wtime() - start;
+	return matches;
+}
+
+/*
+This method times one type of search with the current engine and thread count and prints its CSV line
+*/
+void benchmarkKernel(benchmarkOptions_ *options, char type, double *times)
+{
+	double seconds, mean = 0, variance = 0;
+	long long matches = runKernel(type, &seconds); //warm up, not timed
+
+	for (int rep = 0; rep < options->reps; rep++)
+	{
+		runKernel(type, &times[rep]);
+		mean += times[rep];
+	}
+	mean /= options->reps;
+	for (int rep = 0; rep < options->reps; rep++)
+		variance += (times[rep] - mean) * (times[rep] - mean);
+	if (options->reps > 1)
+		variance /= options->reps - 1;
+
+	printf("%s,%lld,%d,%lld,%g,%s,%s,%d,%d,%lld,%.6f,%.6f,%.3f,%.0f\n",
+		options->corpus, textLength, options->alphabet, patternLength, options->density,
+		searchEngineName(engineType), type == '0' ? "exists" : type == '2' ? "count" : "findall", num_threads, options->reps, matches,
+		mean, sqrt(variance), mean > 0 ? textLength / mean / 1e9 : 0.0, mean > 0 ? matches / mean : 0.0);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	benchmarkOptions_ options;
+	searchEngineType_ engines[] = {ENGINE_NAIVE, ENGINE_HORSPOOL, ENGINE_TWO_WAY};
+	char types[] = {'0', '1', '2'};
+
+	parseBenchmarkArguments(argc, argv, &options);
+	generateCorpus(&options);
+	double *times = (double *) malloc(sizeof(double) * options.reps);
+	if (times == NULL)
+		outOfMemory();
+
+	printf("corpus,text_bytes,alphabet,pattern_length,density_per_mb,engine,search,threads,reps,matches,mean_seconds,stddev_seconds,gb_per_s,matches_per_s\n");
+	for (int e = 0; e < 3; e++)
+	{
+		if (options.allEngines)
+			engineType = engines[e];
+		else if (e > 0)
+			break;
+		prepareSearchEngine(&engine, engineType, patternData, (int) patternLength);
+		for (int t = 0; t < 3; t++)
+		{
+			for (int n = 0; n < options.numThreadCounts; n++)
+			{
+				num_threads = options.threadCounts[n];
+				benchmarkKernel(&options, types[t], times);
+			}
+		}
+	}
+
+	free(times);
+	free(textData);
+	free(patternData);
+	return 0;
+}
+#endif
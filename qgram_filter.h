@@ -0,0 +1,201 @@
+#ifndef QGRAM_FILTER_H
+#define QGRAM_FILTER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "text_io.h"
+#include "text_index.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Q-GRAM PRESENCE FILTER - shared by project_OMP.c and project_MPI.c
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Most type '0' searches do not find their pattern, and those are the most expensive ones as the whole
+text has to be scanned to be sure. project_OMP --build-filter saves a bitmap of every 3-gram (run of
+QGRAM_LENGTH characters) that occurs in each text of the control file as text%s.qg, next to text%s.txt.
+A pattern can only occur in the text if every one of its 3-grams does, so before a type '0' search the
+pattern's 3-grams are looked up in the bitmap, and if any is missing the answer is -1 in O(m) without
+loading or scanning the text. Otherwise the filter can not tell and the text is searched as normal.
+Patterns shorter than QGRAM_LENGTH are always searched.
+
+There are 2^24 possible 3-grams, so the bitmap is 2MB whatever the size of the text and has no false
+positives for a single 3-gram. The file is a 16 byte header (QGRAM_FILTER_MAGIC and the length of the
+text it was built from) followed by the bitmap, and is only used if it was modified after the text and
+was built from a text of the same length, like the suffix array index (see text_index.h).
+*/
+
+#define QGRAM_LENGTH 3
+#define QGRAM_FILTER_WORDS ((1 << (8 * QGRAM_LENGTH)) / 64) //64-bit words in the bitmap, one bit per possible 3-gram
+#define QGRAM_FILTER_MAGIC "QGRAMS03"
+#define QGRAM_FILTER_HEADER_LENGTH 16 //magic followed by the text length
+
+typedef struct qgramFilter
+{
+	long long textLength; //length of the text the filter was built from
+	const unsigned long long *bits; //bit q is set if 3-gram q occurs in the text
+	char *data; //the whole filter file
+	long long dataLength;
+	bool isMapped;
+} qgramFilter_;
+
+/*
+This method returns the 3-gram starting at text as a number, the first character in the highest bits
+*/
+static inline unsigned int qgramAt(const char *text)
+{
+	const unsigned char *chars = (const unsigned char *) text;
+	return ((unsigned int) chars[0] << 16) | ((unsigned int) chars[1] << 8) | chars[2];
+}
+
+/*
+This method builds the 3-gram bitmap of the text of length textLength using numThreads threads. Each
+thread marks the 3-grams of one slice of the text in a bitmap of its own, then the bitmaps are combined
+in parallel, so no thread ever waits on another. Returns NULL if memory could not be allocated,
+otherwise a bitmap of QGRAM_FILTER_WORDS words that the caller frees.
+*/
+static inline unsigned long long *buildQgramFilter(const char *text, long long textLength, int numThreads)
+{
+	unsigned long long *bits = (unsigned long long *) calloc(QGRAM_FILTER_WORDS, sizeof(unsigned long long));
+	unsigned long long **threadBits = (unsigned long long **) calloc(numThreads, sizeof(unsigned long long *));
+	long long numQgrams = textLength - QGRAM_LENGTH + 1;
+	bool allocated = bits != NULL && threadBits != NULL;
+	for (int t = 0; allocated && t < numThreads; t++)
+	{
+		threadBits[t] = (unsigned long long *) calloc(QGRAM_FILTER_WORDS, sizeof(unsigned long long));
+		allocated = threadBits[t] != NULL;
+	}
+
+	if (allocated && numQgrams > 0)
+	{
+#ifdef _OPENMP
+		#pragma omp parallel for shared(text, threadBits) num_threads(numThreads) schedule(static)
+#endif
+		for (int t = 0; t < numThreads; t++)
+		{
+			unsigned long long *myBits = threadBits[t];
+			long long first = numQgrams * t / numThreads;
+			long long end = numQgrams * (t + 1) / numThreads;
+			for (long long i = first; i < end; i++)
+			{
+				unsigned int qgram = qgramAt(text + i);
+				myBits[qgram / 64] |= 1ULL << (qgram % 64);
+			}
+		}
+
+#ifdef _OPENMP
+		#pragma omp parallel for shared(bits, threadBits) num_threads(numThreads) schedule(static)
+#endif
+		for (long long w = 0; w < QGRAM_FILTER_WORDS; w++)
+		{
+			for (int t = 0; t < numThreads; t++)
+				bits[w] |= threadBits[t][w];
+		}
+	}
+
+	for (int t = 0; threadBits != NULL && t < numThreads; t++)
+		free(threadBits[t]);
+	free(threadBits);
+	if (!allocated)
+	{
+		free(bits);
+		return NULL;
+	}
+	return bits;
+}
+
+/*
+This method writes the bitmap of a text of length textLength to filterFile, through a temporary file
+that is then renamed so a filter that was only partly written is never used.
+Returns false if the file could not be written.
+*/
+static inline bool writeQgramFilter(const char *filterFile, const unsigned long long *bits, long long textLength)
+{
+	char tempFile[1100];
+	char header[QGRAM_FILTER_HEADER_LENGTH];
+	snprintf(tempFile, sizeof(tempFile), "%s.tmp", filterFile);
+	FILE *f = fopen(tempFile, "wb");
+	if (f == NULL)
+		return false;
+
+	memcpy(header, QGRAM_FILTER_MAGIC, 8);
+	memcpy(header + 8, &textLength, sizeof(long long));
+	bool written = fwrite(header, 1, QGRAM_FILTER_HEADER_LENGTH, f) == QGRAM_FILTER_HEADER_LENGTH &&
+		fwrite(bits, sizeof(unsigned long long), QGRAM_FILTER_WORDS, f) == QGRAM_FILTER_WORDS;
+	if (fclose(f) != 0 || !written || rename(tempFile, filterFile) != 0)
+	{
+		remove(tempFile);
+		return false;
+	}
+	return true;
+}
+
+/*
+This method loads filterFile, mapping it if possible. Returns false if it can not be read, is not a
+filter or was built from a text of a different length than textLength.
+*/
+static bool loadQgramFilter(const char *filterFile, long long textLength, qgramFilter_ *filter)
+{
+	memset(filter, 0, sizeof(qgramFilter_));
+	filter->isMapped = mapFile(filterFile, &filter->data, &filter->dataLength);
+	if (!filter->isMapped)
+	{
+		FILE *f = fopen(filterFile, "rb");
+		if (f == NULL)
+			return false;
+		bool read = readFileBuffered(f, &filter->data, &filter->dataLength);
+		fclose(f);
+		if (!read)
+			return false;
+	}
+
+	if (filter->dataLength >= QGRAM_FILTER_HEADER_LENGTH)
+		memcpy(&filter->textLength, filter->data + 8, sizeof(long long));
+	if (filter->dataLength != QGRAM_FILTER_HEADER_LENGTH + QGRAM_FILTER_WORDS * (long long) sizeof(unsigned long long) ||
+		memcmp(filter->data, QGRAM_FILTER_MAGIC, 8) != 0 || filter->textLength != textLength)
+	{
+		releaseFile(filter->data, filter->dataLength, filter->isMapped);
+		memset(filter, 0, sizeof(qgramFilter_));
+		return false;
+	}
+	filter->bits = (const unsigned long long *) (filter->data + QGRAM_FILTER_HEADER_LENGTH);
+	return true;
+}
+
+/*
+This method loads the filter of textFile from filterFile if it was modified after the text and was built
+from it. Returns false if there is no usable filter, in which case the text has to be searched.
+*/
+static bool loadFreshQgramFilter(const char *textFile, const char *filterFile, qgramFilter_ *filter)
+{
+	struct stat textInfo;
+	memset(filter, 0, sizeof(qgramFilter_));
+	if (!textIndexIsFresh(textFile, filterFile) || stat(textFile, &textInfo) != 0)
+		return false;
+	return loadQgramFilter(filterFile, (long long) textInfo.st_size, filter);
+}
+
+static void releaseQgramFilter(qgramFilter_ *filter)
+{
+	releaseFile(filter->data, filter->dataLength, filter->isMapped);
+	memset(filter, 0, sizeof(qgramFilter_));
+}
+
+/*
+This method returns false if the pattern can not occur in the filter's text because one of its 3-grams
+never does, and true if it might occur
+*/
+static bool qgramFilterAllows(const qgramFilter_ *filter, const char *pattern, long long patternLength)
+{
+	for (long long i = 0; i + QGRAM_LENGTH <= patternLength; i++)
+	{
+		unsigned int qgram = qgramAt(pattern + i);
+		if ((filter->bits[qgram / 64] & (1ULL << (qgram % 64))) == 0)
+			return false;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,387 @@
+#ifndef SEARCH_ENGINES_H
+#define SEARCH_ENGINES_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(NO_SIMD)
+#define SEARCH_ENGINES_X86
+#include <immintrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// SEARCH ENGINES - shared by project_OMP.c and project_MPI.c
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Each engine finds the occurrences of one pattern in a range of start positions of a text. The
+parallel code in the two programs decides which range each thread or process searches, and the
+engine decides how to search it. Three engines are available and one is chosen per run with
+the --engine= command line option:
+
+naive    - the original hostMatch, tries every start position in turn. O(n*m) in the worst case.
+           On x86 the start positions are first filtered with SIMD: the first and last pattern bytes
+           are compared against 32 (AVX2) or 16 (SSE2) text positions at once and only positions
+           matching both are compared in full. The widest kernel the CPU supports is picked at run
+           time with CPUID, with a scalar loop as the fallback (and with -DNO_SIMD).
+horspool - Boyer-Moore-Horspool. Compares the pattern from its last character and uses a skip
+           table built from the pattern to jump up to patternLength positions at a time.
+           Sublinear on average, best for long patterns over large alphabets.
+twoway   - Crochemore-Perrin Two-Way. Splits the pattern at its critical factorisation and
+           matches the right half then the left half. Linear time in the worst case with
+           constant extra space, so patterns such as aaaa...ab can not cause quadratic work.
+
+All engines report exactly the same set of positions, including overlapping occurrences.
+*/
+
+typedef enum searchEngineType
+{
+	ENGINE_NAIVE,
+	ENGINE_HORSPOOL,
+	ENGINE_TWO_WAY
+} searchEngineType_;
+
+typedef enum simdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2
+} simdLevel_;
+
+typedef struct searchEngine
+{ //holds a pattern and everything that was precomputed from it, read-only once prepared so it can be shared by all threads
+	searchEngineType_ type;
+	simdLevel_ simdLevel; //naive: which candidate filter kernel to use
+	const unsigned char *pattern;
+	int patternLength;
+	int skipTable[256]; //horspool: how far to shift given the text character under the last pattern position
+	int criticalPos; //two-way: last position of the left half of the critical factorisation (may be -1)
+	int period; //two-way: period of the pattern if periodic, otherwise the shift used after a match
+	bool periodic; //two-way: true if the left half is a suffix of the right half's period
+} searchEngine_;
+
+typedef struct searchCursor
+{ //position of one thread's search within its range, so an engine can carry state between matches
+	long long position; //next start position to try, 64-bit so texts over 2GB can be searched
+	int memory; //two-way: length of the pattern prefix already known to match at position, -1 if none
+} searchCursor_;
+
+/*
+This method converts the name given on the command line to an engine type.
+Returns false if the name is not recognised.
+*/
+static bool parseSearchEngine(const char *name, searchEngineType_ *type)
+{
+	if (strcmp(name, "naive") == 0)
+		*type = ENGINE_NAIVE;
+	else if (strcmp(name, "horspool") == 0)
+		*type = ENGINE_HORSPOOL;
+	else if (strcmp(name, "twoway") == 0)
+		*type = ENGINE_TWO_WAY;
+	else
+		return false;
+	return true;
+}
+
+static const char *searchEngineName(searchEngineType_ type)
+{
+	switch (type)
+	{
+		case ENGINE_HORSPOOL: return "horspool";
+		case ENGINE_TWO_WAY: return "twoway";
+		default: return "naive";
+	}
+}
+
+/*
+This method picks the widest candidate filter kernel the CPU supports, using CPUID.
+*/
+static simdLevel_ detectSimdLevel(void)
+{
+#ifdef SEARCH_ENGINES_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIMD_SSE2;
+#endif
+	return SIMD_SCALAR;
+}
+
+static const char *simdLevelName(simdLevel_ level)
+{
+	switch (level)
+	{
+		case SIMD_AVX2: return "avx2";
+		case SIMD_SSE2: return "sse2";
+		default: return "scalar";
+	}
+}
+
+/*
+Checks the middle of a candidate whose first and last bytes are already known to match.
+*/
+static inline bool candidateMatches(const unsigned char *text, const unsigned char *x, int m)
+{
+	return m <= 2 || memcmp(text + 1, x + 1, m - 2) == 0;
+}
+
+/*
+The candidate filter kernels below return the first start position between pos and lastStart
+(inclusive) at which the pattern occurs, or lastStart + 1 if there is none. Text positions are
+long long throughout so texts longer than 2GB can be searched, only the pattern length is an int.
+*/
+static long long naiveScalar(const unsigned char *text, long long pos, long long lastStart, const unsigned char *x, int m)
+{
+	for (; pos <= lastStart; pos++)
+	{
+		if (text[pos] == x[0] && text[pos + m - 1] == x[m - 1] && candidateMatches(text + pos, x, m))
+			return pos;
+	}
+	return pos;
+}
+
+#ifdef SEARCH_ENGINES_X86
+__attribute__((target("sse2")))
+static long long naiveSse2(const unsigned char *text, long long pos, long long lastStart, const unsigned char *x, int m)
+{
+	const __m128i first = _mm_set1_epi8((char) x[0]);
+	const __m128i last = _mm_set1_epi8((char) x[m - 1]);
+	for (; pos + 15 <= lastStart; pos += 16)
+	{ //both loads stay inside the text as the last one ends at pos + 15 + m - 1
+		__m128i blockFirst = _mm_loadu_si128((const __m128i *) (text + pos));
+		__m128i blockLast = _mm_loadu_si128((const __m128i *) (text + pos + m - 1));
+		unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+		while (mask != 0)
+		{ //verify the candidates in order so the first match is returned
+			int bit = __builtin_ctz(mask);
+			if (candidateMatches(text + pos + bit, x, m))
+				return pos + bit;
+			mask &= mask - 1;
+		}
+	}
+	return naiveScalar(text, pos, lastStart, x, m);
+}
+
+__attribute__((target("avx2")))
+static long long naiveAvx2(const unsigned char *text, long long pos, long long lastStart, const unsigned char *x, int m)
+{
+	const __m256i first = _mm256_set1_epi8((char) x[0]);
+	const __m256i last = _mm256_set1_epi8((char) x[m - 1]);
+	for (; pos + 31 <= lastStart; pos += 32)
+	{ //both loads stay inside the text as the last one ends at pos + 31 + m - 1
+		__m256i blockFirst = _mm256_loadu_si256((const __m256i *) (text + pos));
+		__m256i blockLast = _mm256_loadu_si256((const __m256i *) (text + pos + m - 1));
+		unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+		while (mask != 0)
+		{ //verify the candidates in order so the first match is returned
+			int bit = __builtin_ctz(mask);
+			if (candidateMatches(text + pos + bit, x, m))
+				return pos + bit;
+			mask &= mask - 1;
+		}
+	}
+	return naiveScalar(text, pos, lastStart, x, m);
+}
+#endif
+
+/*
+This method computes the maximal suffix of the pattern under the normal alphabet order, or under
+the reversed order if reverse is true. It returns the position before the suffix starts and sets
+period to the period of the suffix. Taken from the Two-Way description by Charras and Lecroq.
+*/
+static int maximalSuffix(const unsigned char *x, int m, int *period, bool reverse)
+{
+	int ms = -1, j = 0, k = 1, p = 1;
+	while (j + k < m)
+	{
+		unsigned char a = x[j + k];
+		unsigned char b = x[ms + k];
+		if (reverse ? a > b : a < b)
+		{ //suffix starting at ms is still the maximum, extend it
+			j += k;
+			k = 1;
+			p = j - ms;
+		}
+		else if (a == b)
+		{ //still repeating the current period
+			if (k != p)
+				k++;
+			else
+			{
+				j += p;
+				k = 1;
+			}
+		}
+		else
+		{ //found a larger suffix, restart from here
+			ms = j;
+			j = ms + 1;
+			k = p = 1;
+		}
+	}
+	*period = p;
+	return ms;
+}
+
+/*
+This method fills in an engine for the given pattern. It must be called before searching and
+the pattern must stay in memory while the engine is in use.
+*/
+static void prepareSearchEngine(searchEngine_ *engine, searchEngineType_ type, const char *pattern, int patternLength)
+{
+	engine->type = type;
+	engine->simdLevel = detectSimdLevel();
+	engine->pattern = (const unsigned char *) pattern;
+	engine->patternLength = patternLength;
+	engine->criticalPos = 0;
+	engine->period = 0;
+	engine->periodic = false;
+
+	if (type == ENGINE_HORSPOOL)
+	{ //shift by the distance from the last occurrence of each character to the end of the pattern
+		for (int c = 0; c < 256; c++)
+			engine->skipTable[c] = patternLength;
+		for (int i = 0; i < patternLength - 1; i++)
+			engine->skipTable[engine->pattern[i]] = patternLength - 1 - i;
+	}
+	else if (type == ENGINE_TWO_WAY)
+	{ //the critical factorisation is the later of the two maximal suffixes
+		int p, q;
+		int i = maximalSuffix(engine->pattern, patternLength, &p, false);
+		int j = maximalSuffix(engine->pattern, patternLength, &q, true);
+		if (i > j)
+		{
+			engine->criticalPos = i;
+			engine->period = p;
+		}
+		else
+		{
+			engine->criticalPos = j;
+			engine->period = q;
+		}
+
+		engine->periodic = memcmp(engine->pattern, engine->pattern + engine->period, engine->criticalPos + 1) == 0;
+		if (!engine->periodic)
+		{ //without a period a match lets us move past both halves
+			int left = engine->criticalPos + 1;
+			int right = patternLength - engine->criticalPos - 1;
+			engine->period = (left > right ? left : right) + 1;
+		}
+	}
+}
+
+static void startSearchCursor(searchCursor_ *cursor, long long from)
+{
+	cursor->position = from;
+	cursor->memory = -1;
+}
+
+/*
+This method returns the next start position between cursor->position and lastStart (inclusive)
+at which the pattern occurs, or -1 if there are no more. The cursor is moved on so that calling
+it again continues the search. The text must be readable up to lastStart + patternLength - 1.
+*/
+static long long searchEngineNext(const searchEngine_ *engine, const char *textChars, long long lastStart, searchCursor_ *cursor)
+{
+	const unsigned char *text = (const unsigned char *) textChars;
+	const unsigned char *x = engine->pattern;
+	int m = engine->patternLength;
+	long long pos = cursor->position;
+
+	if (engine->type == ENGINE_HORSPOOL)
+	{
+		while (pos <= lastStart)
+		{
+			unsigned char last = text[pos + m - 1];
+			if (last == x[m - 1] && memcmp(text + pos, x, m - 1) == 0)
+			{
+				cursor->position = pos + 1;
+				return pos;
+			}
+			pos += engine->skipTable[last];
+		}
+	}
+	else if (engine->type == ENGINE_TWO_WAY)
+	{
+		int ell = engine->criticalPos;
+		int i;
+		if (engine->periodic)
+		{
+			int memory = cursor->memory;
+			while (pos <= lastStart)
+			{
+				//match the right half, skipping what is already known to match
+				i = (ell > memory ? ell : memory) + 1;
+				while (i < m && x[i] == text[pos + i])
+					i++;
+				if (i >= m)
+				{ //then the left half, back to the part already matched
+					i = ell;
+					while (i > memory && x[i] == text[pos + i])
+						i--;
+					if (i <= memory)
+					{
+						cursor->position = pos + engine->period;
+						cursor->memory = m - engine->period - 1;
+						return pos;
+					}
+					pos += engine->period;
+					memory = m - engine->period - 1;
+				}
+				else
+				{
+					pos += i - ell;
+					memory = -1;
+				}
+			}
+		}
+		else
+		{
+			while (pos <= lastStart)
+			{
+				i = ell + 1;
+				while (i < m && x[i] == text[pos + i])
+					i++;
+				if (i >= m)
+				{
+					i = ell;
+					while (i >= 0 && x[i] == text[pos + i])
+						i--;
+					if (i < 0)
+					{
+						cursor->position = pos + engine->period;
+						return pos;
+					}
+					pos += engine->period;
+				}
+				else
+				{
+					pos += i - ell;
+				}
+			}
+		}
+	}
+	else
+	{ //naive: the original hostMatch, with the start positions filtered by the first and last pattern bytes
+		switch (engine->simdLevel)
+		{
+#ifdef SEARCH_ENGINES_X86
+			case SIMD_AVX2: pos = naiveAvx2(text, pos, lastStart, x, m); break;
+			case SIMD_SSE2: pos = naiveSse2(text, pos, lastStart, x, m); break;
+#endif
+			default: pos = naiveScalar(text, pos, lastStart, x, m); break;
+		}
+		if (pos <= lastStart)
+		{
+			cursor->position = pos + 1;
+			return pos;
+		}
+	}
+
+	cursor->position = pos;
+	cursor->memory = -1;
+	return -1;
+}
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "text_io.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// PERSISTENT SUFFIX ARRAY INDEX - shared by project_OMP.c and project_MPI.c
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+When the same text is searched for many different patterns, each search no longer has to scan the
+whole text. project_OMP --build-index builds a suffix array of each text in the control file (every
+start position, sorted by the suffix of the text that starts there) and saves it as text%s.sa next to
+text%s.txt. All occurrences of a pattern are then next to each other in the suffix array and are found
+with two binary searches, in O(m log n) character comparisons for a pattern of length m, plus the time
+to sort the occ positions found so they are reported in ascending order.
+
+The index file is a 16 byte header (TEXT_INDEX_MAGIC and the length of the text it was built from)
+followed by the suffix array as 64-bit positions, so it is 8 bytes per character of text. It is mapped
+read-only like the texts. An index is only used if it was modified after the text and was built from a
+text of the same length, otherwise the searches fall back to scanning the text.
+
+The suffix array is built by prefix doubling: suffixes are first bucketed by their first character,
+and each round sorts every bucket that still holds more than one suffix by the rank of the suffix h
+characters further on, doubling h, until every suffix is in a bucket of its own. The buckets are
+independent so each round sorts them in parallel. Building needs about 32 bytes per character of text.
+*/
+
+#define TEXT_INDEX_MAGIC "SUFARR64"
+#define TEXT_INDEX_HEADER_LENGTH 16 //magic followed by the text length, keeps the positions 8 byte aligned
+
+typedef struct textIndex
+{
+	long long textLength; //length of the text the index was built from
+	const long long *suffixes; //every start position in the text, in sorted order of the suffixes
+	char *data; //the whole index file
+	long long dataLength;
+	bool isMapped;
+} textIndex_;
+
+typedef struct suffixKey
+{ //a suffix and the rank it is sorted by in the current round
+	long long key;
+	long long position;
+} suffixKey_;
+
+static int compareSuffixKeys(const void *a, const void *b)
+{
+	long long keyA = ((const suffixKey_ *) a)->key;
+	long long keyB = ((const suffixKey_ *) b)->key;
+	return (keyA > keyB) - (keyA < keyB);
+}
+
+static int comparePositions(const void *a, const void *b)
+{
+	long long positionA = *(const long long *) a;
+	long long positionB = *(const long long *) b;
+	return (positionA > positionB) - (positionA < positionB);
+}
+
+/*
+This method returns true if indexFile exists and was modified after textFile
+*/
+static bool textIndexIsFresh(const char *textFile, const char *indexFile)
+{
+	struct stat textInfo, indexInfo;
+	if (stat(textFile, &textInfo) != 0 || stat(indexFile, &indexInfo) != 0)
+		return false;
+	if (indexInfo.st_mtim.tv_sec != textInfo.st_mtim.tv_sec)
+		return indexInfo.st_mtim.tv_sec > textInfo.st_mtim.tv_sec;
+	return indexInfo.st_mtim.tv_nsec > textInfo.st_mtim.tv_nsec;
+}
+
+/*
+This method builds the suffix array of the text of length textLength using numThreads threads. It
+returns false if memory could not be allocated, otherwise suffixes is set to an array of textLength
+positions that the caller frees.
+*/
+static inline bool buildSuffixArray(const char *text, long long textLength, int numThreads, long long **suffixes)
+{
+	long long counts[257] = {0};
+	long long *order = (long long *) malloc(sizeof(long long) * (textLength > 0 ? textLength : 1));
+	long long *rank = (long long *) malloc(sizeof(long long) * (textLength > 0 ? textLength : 1));
+	suffixKey_ *keys = (suffixKey_ *) malloc(sizeof(suffixKey_) * (textLength > 0 ? textLength : 1));
+	long long *groups = NULL; //start and end of every bucket still holding more than one suffix
+	long long allocatedGroups = 0;
+#ifndef _OPENMP
+	(void) numThreads; //only the OpenMP builds sort the buckets in parallel
+#endif
+	if (order == NULL || rank == NULL || keys == NULL)
+	{
+		free(order);
+		free(rank);
+		free(keys);
+		return false;
+	}
+
+	//bucket the suffixes by their first character, the rank of a suffix is the start of its bucket
+	for (long long i = 0; i < textLength; i++)
+		counts[(unsigned char) text[i] + 1]++;
+	for (int c = 1; c < 257; c++)
+		counts[c] += counts[c - 1];
+	for (long long i = 0; i < textLength; i++)
+		rank[i] = counts[(unsigned char) text[i]];
+	for (long long i = 0; i < textLength; i++)
+		order[counts[(unsigned char) text[i]]++] = i;
+
+	for (long long h = 1; ; h *= 2)
+	{
+		//find the buckets that still need sorting
+		long long numGroups = 0;
+		for (long long start = 0, end; start < textLength; start = end)
+		{
+			for (end = start + 1; end < textLength && rank[order[end]] == rank[order[start]]; end++)
+				;
+			if (end - start < 2)
+				continue;
+			if (numGroups == allocatedGroups)
+			{
+				allocatedGroups = allocatedGroups > 0 ? allocatedGroups * 2 : 1024;
+				long long *grown = (long long *) realloc(groups, sizeof(long long) * 2 * allocatedGroups);
+				if (grown == NULL)
+				{
+					free(order);
+					free(rank);
+					free(keys);
+					free(groups);
+					return false;
+				}
+				groups = grown;
+			}
+			groups[2 * numGroups] = start;
+			groups[2 * numGroups + 1] = end;
+			numGroups++;
+		}
+		if (numGroups == 0)
+			break;
+
+		//sort each bucket by the rank h characters on, a suffix that ends before then comes first
+#ifdef _OPENMP
+		#pragma omp parallel for shared(text, order, rank, keys, groups) num_threads(numThreads) schedule(dynamic)
+#endif
+		for (long long g = 0; g < numGroups; g++)
+		{
+			long long start = groups[2 * g], end = groups[2 * g + 1];
+			for (long long j = start; j < end; j++)
+			{
+				keys[j].position = order[j];
+				keys[j].key = order[j] + h < textLength ? rank[order[j] + h] : -1;
+			}
+			qsort(keys + start, end - start, sizeof(suffixKey_), compareSuffixKeys);
+		}
+
+		//split the buckets, only once every bucket has read the ranks it sorts by
+#ifdef _OPENMP
+		#pragma omp parallel for shared(order, rank, keys, groups) num_threads(numThreads) schedule(dynamic)
+#endif
+		for (long long g = 0; g < numGroups; g++)
+		{
+			long long start = groups[2 * g], end = groups[2 * g + 1];
+			long long head = start;
+			for (long long j = start; j < end; j++)
+			{
+				if (keys[j].key != keys[head].key)
+					head = j;
+				order[j] = keys[j].position;
+				rank[order[j]] = head;
+			}
+		}
+	}
+
+	free(rank);
+	free(keys);
+	free(groups);
+	*suffixes = order;
+	return true;
+}
+
+/*
+This method writes the suffix array of a text of length textLength to indexFile. It is written to a
+temporary file that is then renamed, so an index that was only partly written is never used.
+Returns false if the file could not be written.
+*/
+static inline bool writeTextIndex(const char *indexFile, const long long *suffixes, long long textLength)
+{
+	char tempFile[1100];
+	char header[TEXT_INDEX_HEADER_LENGTH];
+	snprintf(tempFile, sizeof(tempFile), "%s.tmp", indexFile);
+	FILE *f = fopen(tempFile, "wb");
+	if (f == NULL)
+		return false;
+
+	memcpy(header, TEXT_INDEX_MAGIC, 8);
+	memcpy(header + 8, &textLength, sizeof(long long));
+	bool written = fwrite(header, 1, TEXT_INDEX_HEADER_LENGTH, f) == TEXT_INDEX_HEADER_LENGTH &&
+		fwrite(suffixes, sizeof(long long), (size_t) textLength, f) == (size_t) textLength;
+	if (fclose(f) != 0 || !written || rename(tempFile, indexFile) != 0)
+	{
+		remove(tempFile);
+		return false;
+	}
+	return true;
+}
+
+/*
+This method loads indexFile, mapping it if possible. Returns false if it can not be read, is not an
+index or was built from a text of a different length than textLength.
+*/
+static bool loadTextIndex(const char *indexFile, long long textLength, textIndex_ *index)
+{
+	memset(index, 0, sizeof(textIndex_));
+	index->isMapped = mapFile(indexFile, &index->data, &index->dataLength);
+	if (!index->isMapped)
+	{
+		FILE *f = fopen(indexFile, "rb");
+		if (f == NULL)
+			return false;
+		bool read = readFileBuffered(f, &index->data, &index->dataLength);
+		fclose(f);
+		if (!read)
+			return false;
+	}
+
+	if (index->dataLength >= TEXT_INDEX_HEADER_LENGTH)
+		memcpy(&index->textLength, index->data + 8, sizeof(long long));
+	if (index->dataLength < TEXT_INDEX_HEADER_LENGTH || memcmp(index->data, TEXT_INDEX_MAGIC, 8) != 0 ||
+		index->textLength != textLength || index->dataLength != TEXT_INDEX_HEADER_LENGTH + textLength * (long long) sizeof(long long))
+	{
+		releaseFile(index->data, index->dataLength, index->isMapped);
+		memset(index, 0, sizeof(textIndex_));
+		return false;
+	}
+	index->suffixes = (const long long *) (index->data + TEXT_INDEX_HEADER_LENGTH);
+	return true;
+}
+
+static void releaseTextIndex(textIndex_ *index)
+{
+	releaseFile(index->data, index->dataLength, index->isMapped);
+	memset(index, 0, sizeof(textIndex_));
+}
+
+/*
+This method compares the suffix of the text starting at position with the pattern, looking at no
+more than patternLength characters. Returns 0 if the pattern starts there.
+*/
+static int compareSuffix(const char *text, long long textLength, long long position, const char *pattern, long long patternLength)
+{
+	long long length = textLength - position < patternLength ? textLength - position : patternLength;
+	int result = memcmp(text + position, pattern, (size_t) length);
+	if (result != 0)
+		return result;
+	return length < patternLength ? -1 : 0; //a suffix shorter than the pattern sorts before it
+}
+
+/*
+This method finds the range of the suffix array, from first up to but not including end, holding
+every position the pattern starts at. The range is empty if the pattern does not occur.
+*/
+static void findSuffixRange(const textIndex_ *index, const char *text, const char *pattern, long long patternLength,
+	long long *first, long long *end)
+{
+	long long low = 0, high = index->textLength;
+	while (low < high)
+	{ //first suffix not before the pattern
+		long long middle = low + (high - low) / 2;
+		if (compareSuffix(text, index->textLength, index->suffixes[middle], pattern, patternLength) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	*first = low;
+
+	high = index->textLength;
+	while (low < high)
+	{ //first suffix after every suffix the pattern starts
+		long long middle = low + (high - low) / 2;
+		if (compareSuffix(text, index->textLength, index->suffixes[middle], pattern, patternLength) == 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	*end = low;
+}
+
+/*
+This method returns -2 if the pattern occurs in the indexed text and -1 if it does not
+*/
+static int indexFindExists(const textIndex_ *index, const char *text, const char *pattern, long long patternLength)
+{
+	long long first, end;
+	findSuffixRange(index, text, pattern, patternLength, &first, &end);
+	return end > first ? -2 : -1;
+}
+
+/*
+This method returns the number of positions the pattern starts at in the indexed text
+*/
+static long long indexCount(const textIndex_ *index, const char *text, const char *pattern, long long patternLength)
+{
+	long long first, end;
+	findSuffixRange(index, text, pattern, patternLength, &first, &end);
+	return end - first;
+}
+
+/*
+This method finds every position the pattern starts at in the indexed text. It returns the number of
+positions and sets positions to a new array of them in ascending order, or to NULL if there are none.
+Returns -1 if memory could not be allocated.
+*/
+static long long indexFindAll(const textIndex_ *index, const char *text, const char *pattern, long long patternLength,
+	long long **positions)
+{
+	long long first, end;
+	findSuffixRange(index, text, pattern, patternLength, &first, &end);
+	*positions = NULL;
+	if (end == first)
+		return 0;
+
+	*positions = (long long *) malloc(sizeof(long long) * (end - first));
+	if (*positions == NULL)
+		return -1;
+	memcpy(*positions, index->suffixes + first, sizeof(long long) * (end - first));
+	qsort(*positions, end - first, sizeof(long long), comparePositions);
+	return end - first;
+}
+
+#endif
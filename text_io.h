@@ -0,0 +1,141 @@
+#ifndef TEXT_IO_H
+#define TEXT_IO_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// TEXT AND PATTERN LOADING - shared by project_OMP.c and project_MPI.c
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+The text and pattern files are mapped read-only straight into memory instead of being copied
+byte by byte into a heap buffer. The searches only ever read the data, so the mapping can be
+handed to hostMatchFindExists/hostMatchFindAll as it is and the kernel pages it in on demand.
+If a file cannot be mapped (it is empty, it is not a regular file, or the build was made with
+-DNO_MMAP) the caller falls back to reading it into memory with large buffered reads.
+Lengths are long long so texts larger than 2GB can be loaded.
+*/
+
+/*
+This method maps the whole of fileName into memory. It returns true and sets data and length
+if the file was mapped, or false if the caller should fall back to a buffered read.
+*/
+static bool mapFile(const char *fileName, char **data, long long *length)
+{
+#ifdef NO_MMAP
+	return false;
+#else
+	struct stat fileInfo;
+	void *mapping;
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode) || fileInfo.st_size == 0)
+	{ //empty files and pipes can not be mapped, these are left to the buffered read
+		close(fd);
+		return false;
+	}
+
+	mapping = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //the mapping stays valid after the descriptor is closed
+	if (mapping == MAP_FAILED)
+		return false;
+
+	madvise(mapping, fileInfo.st_size, MADV_WILLNEED); //start reading the file in ahead of the search
+	*data = (char *) mapping;
+	*length = (long long) fileInfo.st_size;
+	return true;
+#endif
+}
+
+/*
+This method reads the rest of an open file into a heap buffer using large fread calls. The buffer
+starts at the size of the file when that is known and doubles otherwise, so it is never copied
+more than a logarithmic number of times. Returns false if memory could not be allocated, in which
+case length is set to the size of the allocation that failed.
+*/
+static bool readFileBuffered(FILE *f, char **data, long long *length)
+{
+	struct stat fileInfo;
+	size_t allocatedLength = 65536;
+	size_t resultLength = 0;
+	size_t bytesRead;
+	char *result;
+
+	if (fstat(fileno(f), &fileInfo) == 0 && S_ISREG(fileInfo.st_mode) && fileInfo.st_size > 0)
+	{ //reserve one extra byte so a file of the expected size is read without growing the buffer
+		allocatedLength = (size_t) fileInfo.st_size + 1;
+	}
+
+	result = (char *) malloc(allocatedLength);
+	if (result == NULL)
+	{
+		*length = (long long) allocatedLength;
+		return false;
+	}
+
+	while ((bytesRead = fread(result + resultLength, 1, allocatedLength - resultLength, f)) > 0)
+	{
+		resultLength += bytesRead;
+		if (resultLength == allocatedLength)
+		{ //buffer is full, double it and keep reading
+			char *grown = (char *) realloc(result, allocatedLength * 2);
+			if (grown == NULL)
+			{
+				free(result);
+				*length = (long long) (allocatedLength * 2);
+				return false;
+			}
+			result = grown;
+			allocatedLength *= 2;
+		}
+	}
+
+	if (resultLength == 0)
+	{ //keep the original behaviour of an empty file giving a NULL buffer
+		free(result);
+		result = NULL;
+	}
+	*data = result;
+	*length = (long long) resultLength;
+	return true;
+}
+
+/*
+This method reads length bytes starting at offset from an open file into buffer. It uses pread, which
+does not move the file position, so several threads can read different parts of the same file at once.
+Returns false if the file ends early or the read fails.
+*/
+static inline bool readFileRange(int fd, char *buffer, long long offset, long long length)
+{
+	while (length > 0)
+	{
+		ssize_t bytesRead = pread(fd, buffer, length, (off_t) offset);
+		if (bytesRead <= 0)
+			return false;
+		buffer += bytesRead;
+		offset += bytesRead;
+		length -= bytesRead;
+	}
+	return true;
+}
+
+/*
+This method releases a buffer returned by mapFile or readFileBuffered.
+*/
+static void releaseFile(char *data, long long length, bool isMapped)
+{
+	if (isMapped)
+		munmap(data, length);
+	else
+		free(data);
+}
+
+#endif